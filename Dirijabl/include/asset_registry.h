@@ -0,0 +1,58 @@
+#ifndef ASSET_REGISTRY_H
+#define ASSET_REGISTRY_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "mesh.h"
+#include "texture.h"
+
+// Общие меши и текстуры по пути к файлу.
+//
+// Реестр хранит слабые ссылки: ресурс живёт, пока им пользуется хотя бы
+// одна модель, и повторный запрос того же файла возвращает уже загруженный
+// ресурс вместо повторного разбора и заливки в GPU.
+class AssetRegistry {
+ public:
+  struct Stats {
+    size_t meshLoads = 0;     // Меши, загруженные с диска
+    size_t meshHits = 0;      // Запросы, отданные из реестра
+    size_t textureLoads = 0;
+    size_t textureHits = 0;
+  };
+
+  static AssetRegistry& instance();
+
+  // Получить меш; при первом запросе он загружается с заданными параметрами
+  std::shared_ptr<Mesh> acquireMesh(const std::string& filename,
+                                    const ModelLoadOptions& options = {});
+
+  // Получить текстуру; при первом запросе она загружается
+  std::shared_ptr<Texture> acquireTexture(const std::string& filename);
+
+  // Загрузить заново текстуру, выгруженную Texture::unload(). Пока
+  // загрузка идёт, текстура остаётся белым пикселем.
+  void reloadTexture(const std::shared_ptr<Texture>& texture);
+
+  // Загружать новые ресурсы в фоне через AsyncLoader. До окончания загрузки
+  // меш рисуется кубом, а текстура — белым пикселем.
+  void setAsyncLoading(bool enabled) { asyncLoading = enabled; }
+  bool isAsyncLoading() const { return asyncLoading; }
+
+  const Stats& getStats() const { return stats; }
+
+  // Вывести статистику и объём живых ресурсов
+  void printStats() const;
+
+ private:
+  AssetRegistry() = default;
+
+  std::unordered_map<std::string, std::weak_ptr<Mesh>> meshes;
+  std::unordered_map<std::string, std::weak_ptr<Texture>> textures;
+  Stats stats;
+  bool asyncLoading = false;
+};
+
+#endif  // ASSET_REGISTRY_H
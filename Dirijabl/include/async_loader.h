@@ -0,0 +1,69 @@
+#ifndef ASYNC_LOADER_H
+#define ASYNC_LOADER_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "completion_queue.h"
+#include "mesh.h"
+#include "texture.h"
+#include "thread_pool.h"
+
+// Фоновая загрузка ресурсов.
+//
+// Рабочие потоки читают файлы, разбирают obj и декодируют изображения, а
+// готовые данные через очередь без блокировок возвращаются в главный поток.
+// Заливка в GPU выполняется только в processUploads(), который главный цикл
+// вызывает каждый кадр: контекст OpenGL принадлежит главному потоку.
+class AsyncLoader {
+ public:
+  static AsyncLoader& instance();
+
+  // Прочитать меш в фоне и залить его в mesh, если тот ещё нужен
+  void loadMesh(const std::shared_ptr<Mesh>& mesh, const std::string& filename,
+                const ModelLoadOptions& options);
+
+  // Декодировать изображение в фоне и залить его в texture через буфер
+  // распаковки. Строки копируются в отображённый буфер тоже в фоне.
+  void loadTexture(const std::shared_ptr<Texture>& texture,
+                   const std::string& filename);
+
+  // Залить в GPU всё, что уже прочитано, и проверить fence заливки
+  // текстур. Только из главного потока. Возвращает число обработанных
+  // результатов фоновых задач.
+  size_t processUploads();
+
+  // Отменить загрузку и дождаться фоновых задач. Вызывается из главного
+  // потока, пока контекст OpenGL ещё жив.
+  void shutdown();
+
+  // Ресурсы, которые ещё читаются или ждут заливки
+  size_t getPendingCount() const { return pending.load(); }
+
+ private:
+  AsyncLoader();
+  ~AsyncLoader();
+
+  CompletionQueue<std::function<void()>> completed;
+  std::atomic<size_t> pending{0};
+  std::atomic<bool> cancelled{false};
+
+  // Текстуры, у которых заливка отправлена, но fence ещё не сработал
+  std::vector<std::weak_ptr<Texture>> uploading;
+
+  void finishTextureUpload(const std::shared_ptr<Texture>& texture,
+                           const std::shared_ptr<TextureData>& data,
+                           const std::string& filename);
+
+  // Общий пул создаётся раньше загрузчика, чтобы пережить его при выходе:
+  // задачи загрузчика разбирают obj на общем пуле
+  ThreadPool& shared;
+
+  // Пул объявлен последним, чтобы его потоки завершились раньше очереди
+  ThreadPool pool;
+};
+
+#endif  // ASYNC_LOADER_H
@@ -0,0 +1,79 @@
+#ifndef COMPLETION_QUEUE_H
+#define COMPLETION_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+// Очередь без блокировок: много производителей, один потребитель.
+//
+// Производители (рабочие потоки) кладут элементы в стек через CAS.
+// Потребитель (главный поток) забирает весь стек одной операцией exchange и
+// разворачивает его, чтобы обработать элементы в порядке добавления.
+template <typename T>
+class CompletionQueue {
+ public:
+  CompletionQueue() = default;
+  ~CompletionQueue() { release(head.exchange(nullptr)); }
+
+  CompletionQueue(const CompletionQueue&) = delete;
+  CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+  // Добавить элемент; можно вызывать из любого потока
+  void push(T value) {
+    Node* node =
+        new Node{std::move(value), head.load(std::memory_order_relaxed)};
+    while (!head.compare_exchange_weak(node->next, node,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed)) {
+    }
+  }
+
+  // Обработать все накопленные элементы; только из потока-потребителя.
+  // Возвращает число обработанных элементов.
+  template <typename F>
+  size_t drain(F&& handler) {
+    Node* list = head.exchange(nullptr, std::memory_order_acquire);
+    if (!list) return 0;
+
+    // Стек хранит элементы в обратном порядке
+    Node* ordered = nullptr;
+    while (list) {
+      Node* next = list->next;
+      list->next = ordered;
+      ordered = list;
+      list = next;
+    }
+
+    size_t count = 0;
+    while (ordered) {
+      Node* next = ordered->next;
+      handler(ordered->value);
+      delete ordered;
+      ordered = next;
+      count++;
+    }
+    return count;
+  }
+
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == nullptr;
+  }
+
+ private:
+  struct Node {
+    T value;
+    Node* next;
+  };
+
+  static void release(Node* node) {
+    while (node) {
+      Node* next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+
+  std::atomic<Node*> head{nullptr};
+};
+
+#endif  // COMPLETION_QUEUE_H
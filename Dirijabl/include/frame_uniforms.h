@@ -0,0 +1,51 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+// Точка привязки uniform-блока FrameData во всех программах
+constexpr GLuint kFrameUniformBinding = 0;
+
+// Данные кадра в раскладке std140 блока FrameData основного шейдера.
+// vec3 в std140 выравниваются по 16 байт, поэтому хранятся как vec4.
+struct FrameUniforms {
+  glm::mat4 view = glm::mat4(1.0f);
+  glm::mat4 projection = glm::mat4(1.0f);
+  glm::vec4 viewPos = glm::vec4(0.0f);
+  // DirLight dirLight
+  glm::vec4 lightDirection = glm::vec4(0.0f, -1.0f, 0.0f, 0.0f);
+  glm::vec4 lightAmbient = glm::vec4(0.0f);
+  glm::vec4 lightDiffuse = glm::vec4(0.0f);
+  glm::vec4 lightSpecular = glm::vec4(0.0f);
+  float time = 0.0f;
+  float windStrength = 0.0f;
+  float windFrequency = 0.0f;
+  float padding = 0.0f;
+};
+
+static_assert(sizeof(FrameUniforms) == 224,
+              "FrameUniforms must match the std140 FrameData block");
+
+// Буфер блока FrameData: камера, свет и время, общие для всех моделей,
+// заливаются один раз за кадр вместо отдельных glUniform в каждую
+// программу.
+class FrameUniformBuffer {
+ public:
+  FrameUniformBuffer();
+  ~FrameUniformBuffer();
+
+  FrameUniformBuffer(const FrameUniformBuffer&) = delete;
+  FrameUniformBuffer& operator=(const FrameUniformBuffer&) = delete;
+
+  // Залить данные кадра и привязать буфер к kFrameUniformBinding
+  void update(const FrameUniforms& data);
+
+  GLuint getBuffer() const { return buffer; }
+
+ private:
+  GLuint buffer = 0;
+};
+
+#endif  // FRAME_UNIFORMS_H
@@ -0,0 +1,58 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+#include "vertex.h"
+
+// Ограничивающие объёмы меша в его собственных координатах
+struct Bounds {
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 max = glm::vec3(0.0f);
+  glm::vec3 center = glm::vec3(0.0f);  // Центр AABB
+  float radius = 0.0f;                 // Сфера вокруг центра AABB
+
+  // Посчитать по вершинам; пустой меш даёт точку в начале координат
+  static Bounds fromVertices(const ModelVertex* vertices, size_t count);
+};
+
+// Откуда смотрят при выборе уровня детализации. Уровень годится, если его
+// ошибка упрощения, спроецированная на экран, не больше maxPixelError.
+struct LodView {
+  glm::vec3 position = glm::vec3(0.0f);
+  // Пикселей в единице длины на расстоянии 1: projection[1][1] * высота / 2.
+  // Ноль — всегда рисовать исходную геометрию.
+  float pixelsPerUnit = 0.0f;
+  float maxPixelError = 1.0f;
+  // Камера, которой рисуются импосторы
+  glm::mat4 view = glm::mat4(1.0f);
+  glm::mat4 projection = glm::mat4(1.0f);
+};
+
+// Пирамида видимости: шесть плоскостей, извлечённых из матрицы
+// projection * view. Нормали смотрят внутрь и нормированы, поэтому
+// dot(plane, (p, 1)) — расстояние со знаком.
+class Frustum {
+ public:
+  enum class Result { Outside, Intersects, Inside };
+
+  Frustum() = default;
+  explicit Frustum(const glm::mat4& viewProjection);
+
+  // Сфера в мировых координатах
+  Result testSphere(const glm::vec3& center, float radius) const;
+
+  // AABB меша, перенесённый матрицей model: проверяется описанный вокруг
+  // него мировой AABB
+  bool intersectsBox(const Bounds& bounds, const glm::mat4& model) const;
+
+  // Плоскости (nx, ny, nz, d) в порядке: лево, право, низ, верх, ближняя,
+  // дальняя
+  const glm::vec4* getPlanes() const { return planes; }
+
+ private:
+  glm::vec4 planes[6];
+};
+
+#endif  // FRUSTUM_H
@@ -0,0 +1,129 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Общие вершинные и индексные буферы всех мешей.
+//
+// Вершины лежат в пуле своего формата (сжатые PackedVertex или
+// ModelVertex), индексы — в пуле 16- или 32-битных. Меш занимает в пулах по
+// непрерывному диапазону, а его индексы отсчитываются от первой вершины
+// диапазона и рисуются через glDrawElementsInstancedBaseVertex. На каждое
+// сочетание форматов один VAO, в котором настроены и вершины, и атрибуты
+// экземпляров, поэтому модели с разными мешами рисуются без смены VAO.
+//
+// Освобождённый диапазон уходит в список свободных и сливается с соседними,
+// а новые выделяются из подходящего свободного блока. Когда дыры занимают
+// слишком большую часть пула, живые диапазоны переписываются подряд в новый
+// буфер на GPU. Меш хранит дескриптор, а не смещения, поэтому переезд
+// диапазонов и рост буферов для него незаметны.
+class GeometryArena {
+ public:
+  using Handle = uint32_t;
+  static constexpr Handle kInvalidHandle = 0xffffffffu;
+
+  // Где лежит меш: смещения и размеры в вершинах и индексах пулов
+  struct Range {
+    unsigned int layout = 0;  // Сочетание форматов, номер VAO
+    size_t vertexOffset = 0;
+    size_t vertexCount = 0;
+    size_t indexOffset = 0;
+    size_t indexCount = 0;
+  };
+
+  // Заполненность одного пула, в байтах
+  struct PoolStats {
+    size_t capacity = 0;     // Размер буфера
+    size_t used = 0;         // В живых диапазонах
+    size_t top = 0;          // Граница занятого, за ней пул пуст
+    size_t freeBlocks = 0;   // Дыр ниже границы
+    size_t largestFree = 0;  // Самый большой непрерывный свободный кусок
+    size_t compactions = 0;  // Сколько раз пул уплотнялся
+
+    // Доля свободного места, которую не выделить одним куском: 0 — всё
+    // свободное подряд, ближе к 1 — раздроблено на мелкие дыры
+    float fragmentation() const;
+  };
+
+  static GeometryArena& instance();
+
+  // Выделить диапазоны под меш и залить в них вершины (PackedVertex, если
+  // packed, иначе ModelVertex) и индексы (GLushort, если shortIndices,
+  // иначе GLuint). kInvalidHandle, если меш пуст.
+  Handle allocate(bool packed, bool shortIndices, const void* vertices,
+                  size_t vertexCount, const void* indices, size_t indexCount);
+
+  // Вернуть диапазоны меша в пулы
+  void release(Handle handle);
+
+  const Range& getRange(Handle handle) const { return ranges[handle]; }
+
+  // VAO, через который рисуется меш
+  GLuint getVertexArray(Handle handle) const;
+
+  // Привязать VAO меша и направить атрибуты экземпляров 3-7 на
+  // InstanceTransform в buffer с байта offset. VAO остаётся привязанным.
+  void bind(Handle handle, GLuint buffer, size_t offset);
+
+  // Настроить атрибуты 0-2 меша и индексы в текущем VAO, для рисования
+  // без экземпляров своим VAO (см. getRange для смещений)
+  void setupAttributes(Handle handle) const;
+
+  // Заполненность пулов вершин (по форматам) и индексов (по типам)
+  PoolStats getVertexStats(bool packed) const;
+  PoolStats getIndexStats(bool shortIndices) const;
+
+  // Вывести заполненность всех непустых пулов
+  void printStats() const;
+
+  // Удалить буферы и VAO, пока контекст OpenGL ещё жив
+  void shutdown();
+
+ private:
+  struct Pool {
+    GLuint buffer = 0;
+    size_t unit = 0;      // Байт на вершину или индекс
+    size_t minCapacity = 0;
+    size_t capacity = 0;  // В единицах
+    size_t top = 0;
+    size_t used = 0;
+    std::map<size_t, size_t> freeBlocks;  // Смещение -> размер, ниже top
+    size_t compactions = 0;
+  };
+
+  struct VertexArray {
+    GLuint vao = 0;
+    bool dirty = true;  // Буферы пулов сменились, атрибуты настроить заново
+  };
+
+  // Пулы: вершины сжатые и полные, индексы 16- и 32-битные. Номер VAO —
+  // vertexPool * 2 + indexPool.
+  Pool vertexPools[2];
+  Pool indexPools[2];
+  VertexArray arrays[4];
+
+  std::vector<Range> ranges;
+  std::vector<bool> live;
+  std::vector<Handle> freeHandles;
+
+  GeometryArena();
+  ~GeometryArena() = default;
+
+  GeometryArena(const GeometryArena&) = delete;
+  GeometryArena& operator=(const GeometryArena&) = delete;
+
+  size_t allocateIn(Pool& pool, size_t count);
+  void releaseIn(Pool& pool, size_t offset, size_t count);
+  void grow(Pool& pool, size_t capacity);
+  void compact(Pool& pool, bool vertices);
+  void markDirty(const Pool& pool);
+  PoolStats getStats(const Pool& pool) const;
+  void setupVertexAttributes(unsigned int layout) const;
+};
+
+#endif  // GEOMETRY_ARENA_H
@@ -0,0 +1,110 @@
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+#include "mesh_simplifier.h"
+
+// Буферы отсечения одной модели: VAO, читающий её постоянный буфер
+// экземпляров, и кольцо из трёх наборов буферов transform feedback, по
+// буферу на уровень детализации, с запросами числа записанных экземпляров.
+// Рисуется последний набор, чьи запросы уже готовы, а GPU тем временем
+// заполняет остальные.
+class GpuCullBuffers {
+ public:
+  GpuCullBuffers() = default;
+  ~GpuCullBuffers();
+
+  GpuCullBuffers(const GpuCullBuffers&) = delete;
+  GpuCullBuffers& operator=(const GpuCullBuffers&) = delete;
+
+  // Подготовить буферы под capacity экземпляров из instanceBuffer.
+  // При смене источника или росте ёмкости прошлый результат сбрасывается,
+  // а выходные буферы создаются заново (возможно, под прежними именами);
+  // тогда возвращается true.
+  bool prepare(GLuint instanceBuffer, size_t capacity);
+
+ private:
+  static constexpr int kOutputSets = 3;
+
+  struct OutputSet {
+    GLuint buffers[kMaxLodLevels] = {};
+    GLuint queries[kMaxLodLevels] = {};
+    size_t visible[kMaxLodLevels] = {};  // Прочитано из готовых запросов
+    int lodCount = 0;                    // Сколько уровней записано
+    uint64_t frame = 0;                  // Когда записан
+    bool pending = false;                // Записан, запросы ещё не прочитаны
+  };
+
+  GLuint inputVAO = 0;
+  GLuint source = 0;
+  size_t capacity = 0;
+  OutputSet sets[kOutputSets];
+  int resolved = -1;  // Набор, который рисуется, или -1
+  uint64_t frame = 0;
+
+  void release();
+
+  friend class GpuCuller;
+};
+
+// Отсечение экземпляров на GPU средствами OpenGL 3.3.
+//
+// Вершинный шейдер проверяет сферу каждого экземпляра по плоскостям
+// пирамиды видимости и выбирает уровень детализации по расстоянию,
+// геометрический выпускает точку только для видимых на уровне текущего
+// прохода, и transform feedback записывает их данные подряд в выходной
+// буфер уровня в формате InstanceTransform. Проходов столько же, сколько
+// уровней. Растеризация при этом выключена.
+//
+// Число видимых читается запросом GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN.
+// Чтобы не ждать GPU, запросы только опрашиваются, и рисуется последний
+// набор, чей результат уже готов. Отсечение отстаёт на кадр или больше,
+// если драйвер отстаёт сильнее, и годится для неподвижных экземпляров.
+// CPU ждёт GPU только когда готового набора ещё нет: после создания буферов
+// или смены числа уровней.
+// glDrawTransformFeedbackInstanced здесь не подходит: он берёт из
+// захвата число вершин, а не экземпляров.
+class GpuCuller {
+ public:
+  // Видимые экземпляры по уровням детализации
+  struct Result {
+    GLuint buffers[kMaxLodLevels] = {};  // Откуда читать
+    size_t visible[kMaxLodLevels] = {};  // Сколько их
+  };
+
+  GpuCuller();
+  ~GpuCuller();
+
+  GpuCuller(const GpuCuller&) = delete;
+  GpuCuller& operator=(const GpuCuller&) = delete;
+
+  // Программа собралась
+  bool isValid() const { return program != 0; }
+
+  // Отсечь count экземпляров, разложить их по уровням lods и вернуть
+  // готовый к рисованию результат. Текущая программа сохраняется.
+  Result cull(GpuCullBuffers& buffers, const Frustum& frustum,
+              const LodView& lodView, const Bounds& bounds,
+              const std::vector<MeshLod>& lods, size_t count);
+
+ private:
+  GLuint program = 0;
+  GLint planesLocation = -1;
+  GLint sphereLocation = -1;
+  GLint cameraLocation = -1;
+  GLint pixelsPerUnitLocation = -1;
+  GLint lodErrorsLocation = -1;
+  GLint lodCountLocation = -1;
+  GLint lodLocation = -1;
+
+  // Прочитать число видимых из запросов набора, ожидая их при необходимости
+  static void readResult(GpuCullBuffers::OutputSet& set);
+};
+
+#endif  // GPU_CULLER_H
@@ -0,0 +1,119 @@
+#ifndef IMPOSTOR_RENDERER_H
+#define IMPOSTOR_RENDERER_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+
+class Mesh;
+
+// Когда и как подменять экземпляры модели импосторами
+struct ImpostorSettings {
+  float distance = 60.0f;    // С какого расстояния начинается переход
+  float fadeRange = 10.0f;   // Ширина перехода, на ней видны оба
+  unsigned int views = 8;    // Ракурсов вокруг вертикальной оси
+  unsigned int tileSize = 128;
+  float opacity = 1.0f;      // Множитель прозрачности, как alpha у шейдера
+};
+
+// Атлас ракурсов одной модели: цвет и нормали меша, отрисованные
+// ортографической камерой с views сторон в ряд по tileSize пикселей.
+class ImpostorAtlas {
+ public:
+  explicit ImpostorAtlas(const ImpostorSettings& settings)
+      : settings(settings) {}
+  ~ImpostorAtlas();
+
+  ImpostorAtlas(const ImpostorAtlas&) = delete;
+  ImpostorAtlas& operator=(const ImpostorAtlas&) = delete;
+
+  // Ракурсы уже отрисованы
+  bool isBaked() const { return textures[0] != 0; }
+
+  const ImpostorSettings& getSettings() const { return settings; }
+
+ private:
+  ImpostorSettings settings;
+  GLuint textures[2] = {0, 0};  // Цвет с прозрачностью и нормали
+  GLuint drawVAO = 0;
+  Bounds bounds;                // Сфера меша, вписанная в клетку атласа
+
+  void release();
+
+  friend class ImpostorRenderer;
+};
+
+// Импосторы: дальние экземпляры рисуются четырёхугольником с картинкой
+// меша из атласа вместо самого меша.
+//
+// Атлас запекается один раз, когда меш и текстура загружены: меш
+// рисуется в текстуру с нескольких сторон вокруг оси Y. При рисовании
+// четырёхугольник стоит в системе координат экземпляра и повёрнут вокруг
+// оси Y к камере, а клетка атласа берётся ближайшая по азимуту. Поэтому
+// поворот и неравномерный масштаб экземпляра сохраняются, а освещение
+// считается по запечённым нормалям так же, как в основном шейдере.
+//
+// На переходе экземпляр рисуется и мешем, и импостором, а шейдеры
+// отбрасывают дополняющие друг друга пиксели по матрице Байера. Доля
+// импостора передаётся в normalScale.w; основной шейдер читает её только в
+// вариантах с kShaderImpostorFade.
+class ImpostorRenderer {
+ public:
+  ImpostorRenderer();
+  ~ImpostorRenderer();
+
+  ImpostorRenderer(const ImpostorRenderer&) = delete;
+  ImpostorRenderer& operator=(const ImpostorRenderer&) = delete;
+
+  // Программы собрались
+  bool isValid() const {
+    return bakePrograms[0].id != 0 && bakePrograms[1].id != 0 &&
+           drawProgram != 0;
+  }
+
+  // Направленный свет сцены, как dirLight основного шейдера
+  void setLight(const glm::vec3& direction, const glm::vec3& ambient,
+                const glm::vec3& diffuse);
+
+  // Отрисовать ракурсы уровня 0 меша с текстурой texture в атлас.
+  // target — GL_TEXTURE_2D или GL_TEXTURE_2D_ARRAY, тогда текстура берётся
+  // из слоя layer. Состояние OpenGL сохраняется.
+  bool bake(ImpostorAtlas& atlas, const Mesh& mesh, GLenum target,
+            GLuint texture, int layer = 0) const;
+
+  // Нарисовать count импосторов, чьи InstanceTransform лежат в buffer с
+  // байта offset. Текущая программа и текстуры сохраняются.
+  void draw(const ImpostorAtlas& atlas, GLuint buffer, size_t offset,
+            size_t count, const LodView& view) const;
+
+ private:
+  // Запекание из GL_TEXTURE_2D и из слоя GL_TEXTURE_2D_ARRAY
+  struct BakeProgram {
+    GLuint id = 0;
+    GLint viewProjectionLocation = -1;
+    GLint positionOffsetLocation = -1;
+    GLint positionScaleLocation = -1;
+    GLint layerLocation = -1;
+  };
+  BakeProgram bakePrograms[2];
+
+  GLuint drawProgram = 0;
+  GLint viewLocation = -1;
+  GLint projectionLocation = -1;
+  GLint cameraLocation = -1;
+  GLint sphereLocation = -1;
+  GLint viewsLocation = -1;
+  GLint opacityLocation = -1;
+  GLint lightDirectionLocation = -1;
+  GLint lightAmbientLocation = -1;
+  GLint lightDiffuseLocation = -1;
+
+  glm::vec3 lightDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+  glm::vec3 lightAmbient = glm::vec3(0.3f);
+  glm::vec3 lightDiffuse = glm::vec3(0.8f);
+};
+
+#endif  // IMPOSTOR_RENDERER_H
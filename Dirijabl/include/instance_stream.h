@@ -0,0 +1,61 @@
+#ifndef INSTANCE_STREAM_H
+#define INSTANCE_STREAM_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+// Кольцевой буфер данных экземпляров из трёх областей — по одной на кадр.
+//
+// Пока GPU рисует из одной области, CPU пишет следующую прямо в память,
+// видимую GPU, без промежуточной копии в драйвере. Перед повторной записью
+// в область дожидается её fence, поставленный после рисования.
+// Если есть ARB_buffer_storage, буфер отображается один раз навсегда
+// (persistent + coherent), иначе область отображается каждый кадр
+// с GL_MAP_UNSYNCHRONIZED_BIT: синхронизацию обеспечивают fence.
+class InstanceStream {
+ public:
+  static constexpr int kRegions = 3;
+
+  explicit InstanceStream(size_t stride);
+  ~InstanceStream();
+
+  InstanceStream(const InstanceStream&) = delete;
+  InstanceStream& operator=(const InstanceStream&) = delete;
+
+  // Перейти к следующей области и получить память под count элементов.
+  // Буфер растёт удвоением, если элементов больше, чем помещается.
+  void* map(size_t count);
+
+  // Закончить запись. Возвращает смещение области в буфере в байтах.
+  size_t unmap();
+
+  // Поставить fence после команд рисования из текущей области
+  void fence();
+
+  GLuint getBuffer() const { return buffer; }
+
+  // Элементов в одной области. Меняется, когда map() пересоздаёт буфер; имя
+  // нового буфера при этом может совпасть со старым.
+  size_t getCapacity() const { return capacity; }
+  bool isPersistent() const { return persistent != nullptr; }
+
+  // Сколько раз CPU пришлось ждать GPU перед записью области
+  size_t getStallCount() const { return stallCount; }
+
+ private:
+  GLuint buffer = 0;
+  size_t stride;
+  size_t capacity = 0;  // Элементов в одной области
+  int region = 0;
+  GLsync fences[kRegions] = {};
+  void* persistent = nullptr;
+  bool mapped = false;
+  size_t stallCount = 0;
+
+  void allocate(size_t count);
+  void release();
+  void waitRegion(int index);
+};
+
+#endif  // INSTANCE_STREAM_H
@@ -0,0 +1,73 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// Файл, отображённый в память только для чтения.
+// На POSIX используется mmap, на остальных платформах файл читается в буфер
+// целиком одним вызовом.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string& filename) { open(filename); }
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Отобразить файл; false, если открыть не удалось
+  bool open(const std::string& filename);
+  void close();
+
+  bool isOpen() const { return opened; }
+  const char* data() const { return begin; }
+  size_t size() const { return length; }
+
+ private:
+  const char* begin = nullptr;
+  size_t length = 0;
+  bool opened = false;
+  bool mapped = false;
+  std::vector<char> buffer;
+};
+
+// Проверить файл на доступность: существует, не каталог и не пустой
+bool checkFile(const std::string& filename);
+
+// FNV-1a по произвольному блоку памяти
+uint64_t hashBytes(const void* data, size_t size,
+                   uint64_t seed = 0xcbf29ce484222325ULL);
+
+// Размер и время изменения файла — по ним кэши проверяют исходник
+bool fileStamp(const std::string& filename, uint64_t& size, int64_t& mtime);
+
+// FNV-1a содержимого файла
+bool fileHash(const std::string& filename, uint64_t& hash);
+
+// Перезаписать size байт файла начиная с offset, не меняя длину файла
+bool patchFile(const std::string& filename, size_t offset, const void* data,
+               size_t size);
+
+// Исходник кэша не изменился: совпадают размер и время изменения, а если
+// время другое — хэш содержимого. Тогда новое время записывается в файл
+// кэша по смещению mtimeOffset, чтобы следующий запуск обошёлся без хэша.
+bool sourceMatches(const std::string& filename, uint64_t size, int64_t mtime,
+                   uint64_t hash, const std::string& cachePath,
+                   size_t mtimeOffset);
+
+// Блок данных для writeFileAtomically
+struct FileChunk {
+  const void* data;
+  size_t size;
+};
+
+// Записать блоки подряд во временный файл и переименовать его в filename,
+// чтобы читатель не увидел наполовину записанный файл
+bool writeFileAtomically(const std::string& filename,
+                         std::initializer_list<FileChunk> chunks);
+
+#endif  // MAPPED_FILE_H
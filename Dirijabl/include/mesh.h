@@ -0,0 +1,172 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <glm/glm.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "frustum.h"
+#include "geometry_arena.h"
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "mesh_welder.h"
+#include "obj_parser.h"
+#include "thread_pool.h"
+#include "vertex.h"
+#include "vertex_packing.h"
+
+// Параметры загрузки obj-модели
+struct ModelLoadOptions {
+  // Шаг квантования при склейке вершин, 0 — точное совпадение
+  float weldEpsilon = 0.0f;
+  // Число кусков при параллельном разборе: 0 — по числу ядер,
+  // 1 — разбор в вызывающем потоке
+  unsigned int threads = 0;
+  // Читать и записывать готовый меш в <файл>.dmesh
+  bool useMeshCache = true;
+  // Уровней детализации, включая исходный; 1 — без упрощения
+  unsigned int lodLevels = kDefaultLodLevels;
+  // Хранить вершины в GPU сжатыми (PackedVertex); индексы становятся
+  // 16-битными, когда вершин не больше 65536, в любом случае
+  bool packVertices = true;
+};
+
+// Меш на CPU: результат чтения obj-файла или его кэша, готовый к заливке в
+// GPU. Читается без вызовов OpenGL, поэтому может строиться в рабочем потоке.
+struct MeshData {
+  std::vector<ModelVertex> vertices;
+  std::vector<GLuint> indices;
+  std::vector<MeshLod> lods;
+  WeldStats weldStats;
+  bool fallback = false;
+
+  // Если кэш актуален, данные остаются в отображённом файле и уходят в GPU
+  // прямо из него, а vertices и indices пусты
+  MeshCache cache;
+  bool fromCache = false;
+
+  // Прочитать obj-файл или его кэш; при ошибке — куб
+  bool read(const std::string& filename, const ModelLoadOptions& options);
+
+  // Куб на случай, если модель не загрузилась
+  void makeFallback();
+};
+
+// Геометрия в GPU: вершинный и индексный буферы. Индексы всех уровней
+// детализации лежат в одном буфере подряд, уровень 0 — в начале.
+// На CPU вершины всегда несжатые, сжимаются они при заливке, а формат
+// выбирается при загрузке и дальше не меняется.
+// Буферы в GPU общие для всех мешей (GeometryArena), меш владеет в них
+// диапазоном вершин и диапазоном индексов. Один меш делят все модели,
+// загруженные из одного obj-файла, а экземпляры у каждой модели свои.
+class Mesh {
+ public:
+  // Копия геометрии на CPU; у меша из кэша пуста
+  std::vector<ModelVertex> vertices;
+  std::vector<GLuint> indices;
+
+  size_t indexCount = 0;  // Индексов уровня 0
+
+  Mesh() = default;
+  ~Mesh();
+
+  Mesh(const Mesh&) = delete;
+  Mesh& operator=(const Mesh&) = delete;
+
+  // Загрузить меш из obj-файла; при ошибке создаётся куб
+  bool load(const std::string& filename, const ModelLoadOptions& options);
+
+  // Куб на случай, если модель не загрузилась
+  bool createFallback();
+
+  // Подготовить меш к фоновой загрузке: пока данных нет, рисуется куб.
+  // Отсутствующий файл обнаруживается сразу, и тогда куб остаётся навсегда.
+  bool beginAsyncLoad(const std::string& filename,
+                      const ModelLoadOptions& options = {});
+
+  // Принять прочитанные данные и залить их в GPU. Диапазон заглушки
+  // возвращается в арену; модели ищут диапазон меша при каждом рисовании,
+  // поэтому ничего не замечают.
+  void apply(MeshData& data);
+
+  // Вместо модели из файла используется куб
+  bool isFallback() const { return fallback; }
+
+  // Данные из файла уже в GPU
+  bool isReady() const { return ready; }
+
+  // Статистика склейки вершин при загрузке
+  const WeldStats& getWeldStats() const { return weldStats; }
+
+  // Ограничивающие объёмы текущей геометрии (куба, пока меш грузится)
+  const Bounds& getBounds() const { return bounds; }
+
+  // Уровни детализации; первый — исходная геометрия
+  const std::vector<MeshLod>& getLods() const { return lods; }
+
+  // Вершины в арене сжаты
+  bool isPacked() const { return packed; }
+
+  // Чем шейдер восстанавливает позиции: uniform positionOffset и
+  // positionScale
+  const PositionDecode& getPositionDecode() const { return decode; }
+
+  // Тип и размер индексов в арене: GL_UNSIGNED_SHORT или GL_UNSIGNED_INT
+  GLenum getIndexType() const { return indexType; }
+  size_t getIndexSize() const {
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+  }
+
+  // Байт вершин и индексов в арене
+  size_t getGpuBytes() const { return gpuBytes; }
+
+  // Геометрия залита в арену
+  bool isUploaded() const {
+    return arenaHandle != GeometryArena::kInvalidHandle;
+  }
+
+  // Дескриптор диапазонов меша в GeometryArena
+  GeometryArena::Handle getArenaHandle() const { return arenaHandle; }
+
+  // Первая вершина меша в пуле (base vertex) и первый индекс уровня 0
+  GLint getBaseVertex() const {
+    return static_cast<GLint>(
+        GeometryArena::instance().getRange(arenaHandle).vertexOffset);
+  }
+  size_t getFirstIndex() const {
+    return GeometryArena::instance().getRange(arenaHandle).indexOffset;
+  }
+
+  // VAO арены, общий для мешей того же формата; 0, если меш не залит
+  GLuint getVertexArray() const {
+    return isUploaded() ? GeometryArena::instance().getVertexArray(arenaHandle)
+                        : 0;
+  }
+
+  // Привязать буферы арены к текущему VAO и настроить атрибуты 0-2
+  // (позиция, текстурные координаты, нормаль) под формат вершин
+  void setupAttributes() const;
+
+ private:
+  bool fallback = false;
+  bool ready = false;
+  bool packed = true;
+  WeldStats weldStats;
+  Bounds bounds;
+  std::vector<MeshLod> lods;
+  PositionDecode decode;
+  GLenum indexType = GL_UNSIGNED_INT;
+  size_t gpuBytes = 0;
+  GeometryArena::Handle arenaHandle = GeometryArena::kInvalidHandle;
+
+  void upload(const ModelVertex* vertexData, size_t numVertices,
+              const GLuint* indexData, size_t numIndices);
+};
+
+#endif  // MESH_H
@@ -0,0 +1,75 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "mesh_simplifier.h"
+#include "vertex.h"
+
+// Заголовок файла .dmesh. За ним сразу лежат массив ModelVertex, массив
+// индексов uint32 всех уровней детализации подряд и таблица MeshLod, всё в
+// порядке байтов той машины, на которой файл записан.
+struct DMeshHeader {
+  char magic[4];          // "DMSH"
+  uint32_t version;       // kDMeshVersion
+  uint32_t vertexStride;  // sizeof(ModelVertex)
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  float weldEpsilon;      // С какими параметрами склеены вершины
+  float boundsMin[3];
+  float boundsMax[3];
+  uint32_t lodLevels;     // Сколько уровней детализации запрошено
+  uint32_t lodCount;      // Сколько получилось
+  uint64_t sourceSize;    // Размер obj-файла
+  int64_t sourceMtime;    // Время изменения obj-файла
+  uint64_t sourceHash;    // FNV-1a содержимого obj-файла
+  uint64_t payloadHash;   // FNV-1a вершин, индексов и таблицы уровней
+};
+
+// Готовый к загрузке меш, сохранённый рядом с obj-файлом.
+//
+// Кэш считается актуальным, если совпадают версия формата, параметры
+// склейки и упрощения и размер исходника, а также время изменения
+// исходника или, если оно поменялось, хэш его содержимого.
+class MeshCache {
+ public:
+  static constexpr uint32_t kDMeshVersion = 3;
+
+  // Путь к кэшу для obj-файла
+  static std::string cachePath(const std::string& objPath);
+
+  // Отобразить кэш в память; false, если его нет или он устарел
+  bool open(const std::string& objPath, float weldEpsilon,
+            unsigned int lodLevels);
+  void close();
+
+  // Записать кэш для obj-файла
+  static bool write(const std::string& objPath, float weldEpsilon,
+                    unsigned int lodLevels,
+                    const std::vector<ModelVertex>& vertices,
+                    const std::vector<unsigned int>& indices,
+                    const std::vector<MeshLod>& lods);
+
+  const ModelVertex* getVertices() const { return vertices; }
+  size_t getVertexCount() const { return header ? header->vertexCount : 0; }
+  const uint32_t* getIndices() const { return indices; }
+  size_t getIndexCount() const { return header ? header->indexCount : 0; }
+  const MeshLod* getLods() const { return lods; }
+  size_t getLodCount() const { return header ? header->lodCount : 0; }
+  glm::vec3 getBoundsMin() const;
+  glm::vec3 getBoundsMax() const;
+
+ private:
+  MappedFile file;
+  const DMeshHeader* header = nullptr;
+  const ModelVertex* vertices = nullptr;
+  const uint32_t* indices = nullptr;
+  const MeshLod* lods = nullptr;
+};
+
+#endif  // MESH_CACHE_H
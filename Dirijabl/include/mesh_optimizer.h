@@ -0,0 +1,52 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh_simplifier.h"
+#include "vertex.h"
+
+// Размер кэша вершин после преобразования, на котором меряется ACMR/ATVR.
+// FIFO на 16 записей — осторожная оценка для современных GPU.
+constexpr unsigned int kVertexCacheSize = 16;
+
+// Насколько индексы пользуются кэшем вершин
+struct VertexCacheStats {
+  float acmr = 0.0f;  // Промахов на треугольник: от 0.5 в идеале до 3
+  float atvr = 0.0f;  // Промахов на вершину: 1 в идеале
+};
+
+// Просчитать промахи FIFO-кэша на cacheSize вершин для треугольников
+VertexCacheStats analyzeVertexCache(const unsigned int* indices,
+                                    size_t indexCount, size_t vertexCount,
+                                    unsigned int cacheSize = kVertexCacheSize);
+
+// Переставить треугольники так, чтобы соседние по порядку делили вершины
+// (алгоритм Форсайта: жадный выбор треугольника с наибольшим весом вершин,
+// который растёт для недавно использованных и почти исчерпанных вершин).
+void optimizeVertexCache(unsigned int* indices, size_t indexCount,
+                         size_t vertexCount);
+
+// Уменьшить перерисовку: после optimizeVertexCache разбить треугольники на
+// кластеры по местам, где кэш начинается заново, и рисовать первыми
+// кластеры, смотрящие наружу от центра меша. Если ACMR вырос больше чем в
+// threshold раз, порядок не меняется.
+void optimizeOverdraw(unsigned int* indices, size_t indexCount,
+                      const std::vector<ModelVertex>& vertices,
+                      float threshold);
+
+// Перенумеровать вершины в порядке первого использования, чтобы выборка
+// атрибутов шла по памяти подряд. Неиспользуемые вершины уходят в конец.
+void optimizeVertexFetch(std::vector<ModelVertex>& vertices,
+                         std::vector<unsigned int>& indices);
+
+// Всё вместе для меша с уровнями детализации: каждый уровень
+// оптимизируется отдельно, затем вершины переставляются под общий буфер
+// индексов. Возвращает статистику уровня 0 до и после.
+void optimizeMesh(std::vector<ModelVertex>& vertices,
+                  std::vector<unsigned int>& indices,
+                  const std::vector<MeshLod>& lods, VertexCacheStats& before,
+                  VertexCacheStats& after);
+
+#endif  // MESH_OPTIMIZER_H
@@ -0,0 +1,39 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vertex.h"
+
+// Сколько уровней детализации строится по умолчанию, включая исходный
+constexpr unsigned int kDefaultLodLevels = 4;
+// Больше уровней рендер не различает
+constexpr unsigned int kMaxLodLevels = 4;
+
+// Уровень детализации: диапазон в общем индексном буфере меша
+struct MeshLod {
+  uint32_t indexOffset = 0;
+  uint32_t indexCount = 0;
+  float error = 0.0f;  // Отклонение от исходной поверхности, в единицах модели
+};
+
+// Упростить треугольники методом квадрик ошибок (QEM) до targetIndexCount
+// индексов или меньше. Вершина схлопывается в соседнюю по ребру, поэтому
+// вершины не меняются и все уровни делят один вершинный буфер. Вершины на
+// краях и швах (одна позиция, разные нормали или UV) не трогаются, чтобы
+// не появлялись дыры. Возвращает оценку ошибки: корень из наибольшей
+// средней квадратичной удалённости от плоскостей исходных граней.
+float simplifyMesh(const std::vector<ModelVertex>& vertices,
+                   const std::vector<unsigned int>& indices,
+                   size_t targetIndexCount, std::vector<unsigned int>& result);
+
+// Дописать к indices до levels - 1 упрощённых уровней, каждый примерно
+// вдвое меньше предыдущего. Уровень 0 — исходные индексы. Упрощение
+// прекращается, когда очередной уровень почти не меньше прошлого.
+void buildMeshLods(const std::vector<ModelVertex>& vertices,
+                   std::vector<unsigned int>& indices, unsigned int levels,
+                   std::vector<MeshLod>& lods);
+
+#endif  // MESH_SIMPLIFIER_H
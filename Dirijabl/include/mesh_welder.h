@@ -0,0 +1,70 @@
+#ifndef MESH_WELDER_H
+#define MESH_WELDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "vertex.h"
+
+// Статистика склейки вершин
+struct WeldStats {
+  size_t inputVertices = 0;   // Углов граней на входе
+  size_t outputVertices = 0;  // Уникальных вершин на выходе
+  size_t tripleHits = 0;      // Найдено по тройке индексов OBJ
+  size_t valueHits = 0;       // Найдено по значению вершины
+};
+
+// Склейка одинаковых углов граней в общие вершины.
+//
+// Сначала угол ищется по тройке индексов OBJ (позиция, текстура, нормаль),
+// затем по значению вершины. При epsilon == 0 значения сравниваются точно,
+// как в ModelVertex::operator==, поэтому порядок и набор вершин совпадают с
+// линейным поиском. При epsilon > 0 значения квантуются с шагом epsilon.
+class VertexWelder {
+ public:
+  VertexWelder(std::vector<ModelVertex>& vertices, float epsilon = 0.0f);
+
+  // Зарезервировать место под ожидаемое число углов граней
+  void reserve(size_t corners);
+
+  // Добавить угол грани и получить индекс вершины.
+  // posIdx/texIdx/normIdx — индексы OBJ с нуля, -1 если компонента нет.
+  unsigned int add(const ModelVertex& v, int posIdx, int texIdx, int normIdx);
+
+  const WeldStats& getStats() const { return stats; }
+
+ private:
+  struct TripleKey {
+    int pos, tex, norm;
+    bool operator==(const TripleKey& other) const {
+      return pos == other.pos && tex == other.tex && norm == other.norm;
+    }
+  };
+  struct TripleHash {
+    size_t operator()(const TripleKey& key) const;
+  };
+
+  // Ключ по значению: биты float (точный режим) или номера ячеек сетки
+  struct ValueKey {
+    ModelVertex vertex;
+    int32_t cells[8];
+    bool quantized;
+    bool operator==(const ValueKey& other) const;
+  };
+  struct ValueHash {
+    size_t operator()(const ValueKey& key) const;
+  };
+
+  ValueKey makeValueKey(const ModelVertex& v) const;
+
+  std::vector<ModelVertex>& vertices;
+  float epsilon;
+  WeldStats stats;
+
+  std::unordered_map<TripleKey, unsigned int, TripleHash> byTriple;
+  std::unordered_map<ValueKey, unsigned int, ValueHash> byValue;
+};
+
+#endif  // MESH_WELDER_H
@@ -4,85 +4,250 @@
 #include <GL/glew.h>
 
 #include <SFML/Graphics.hpp>
+#include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <system_error>
 #include <unordered_map>
 #include <vector>
 
-struct ModelVertex {
-  glm::vec3 position;
-  glm::vec2 texCoord;
-  glm::vec3 normal;
-
-  bool operator==(const ModelVertex& other) const {
-    return position == other.position && texCoord == other.texCoord &&
-           normal == other.normal;
-  }
-};
+#include "asset_registry.h"
+#include "frustum.h"
+#include "gpu_culler.h"
+#include "impostor_renderer.h"
+#include "instance_stream.h"
+#include "mesh.h"
+#include "texture.h"
+#include "texture_array.h"
+#include "transform_pool.h"
 
 class ModelInstance;
+class Shader;
 
 class Model {
  public:
-  // Mesh
-  std::vector<ModelVertex> vertices;
-  std::vector<GLuint> indices;
+  // Объём заливки буферов экземпляров. Счётчики кадра сбрасывает
+  // resetFrameUploadStats() в начале кадра.
+  struct UploadStats {
+    size_t frameBytes = 0;   // Байт за текущий кадр
+    size_t frameRanges = 0;  // Вызовов glBufferSubData за текущий кадр
+    size_t totalBytes = 0;   // Байт за всё время
+  };
+
+  // Итог отсечения экземпляров в последнем рисовании модели
+  struct CullStats {
+    size_t visible = 0;
+    size_t culled = 0;
+    size_t triangles = 0;  // Отправлено на отрисовку по всем уровням
+    size_t impostors = 0;  // Видимых, нарисованных импостором
+    size_t drawCalls = 0;  // Вызовов рисования мешей и импосторов
+  };
+
   GLuint texture = 0;
 
-  // Конструктор из файла с obj-моделью
-  Model(const std::string& filename);
+  // Конструктор из файла с obj-моделью.
+  // Меш берётся из общего реестра, поэтому повторная загрузка того же
+  // файла не разбирает его заново.
+  Model(const std::string& filename, const ModelLoadOptions& options = {});
 
-  // Загрузить текстуру
+  // Загрузить текстуру (тоже через общий реестр)
   void loadTexture(const std::string& filename);
 
+  // Вместо модели из файла используется куб
+  bool isFallback() const { return mesh->isFallback(); }
+
+  // Общая геометрия модели
+  const Mesh& getMesh() const { return *mesh; }
+
   // Создать новый экземпляр
-  ModelInstance* createInstance();
+  ModelInstance createInstance();
+
+  // Число живых экземпляров
+  size_t getInstanceCount() const { return transforms.size(); }
+
+  // Преобразования всех экземпляров
+  const TransformPool& getTransforms() const { return transforms; }
+
+  // Статистика склейки вершин при загрузке
+  const WeldStats& getWeldStats() const { return mesh->getWeldStats(); }
+
+  // Писать матрицы экземпляров каждый кадр в кольцевой буфер вместо
+  // заливки изменённых слотов. Выгодно, когда двигается большинство
+  // экземпляров модели.
+  void setInstanceStreaming(bool enabled);
+
+  // Нарисовать все экземпляры текущим вариантом shader
+  void drawAllInstances(Shader& shader) const;
+
+  // Нарисовать только экземпляры, чьи ограничивающие объёмы пересекают
+  // пирамиду видимости. Каждому видимому выбирается уровень детализации
+  // по lodView; данные сжимаются в кольцевой буфер подряд по уровням,
+  // и каждый уровень рисуется своим вызовом.
+  void drawVisibleInstances(Shader& shader, const Frustum& frustum,
+                            const LodView& lodView = {}) const;
+
+  // То же в два шага, как рисует RenderQueue: сначала отсечение и заливка
+  // экземпляров всех моделей, затем вызовы рисования в порядке очереди,
+  // когда программа и текстура уже выставлены. Подготовленное рисуется
+  // один раз. Uniform модели задаются через shader, вариант которого
+  // сейчас выбран.
+  void prepareVisibleInstances(const Frustum& frustum,
+                               const LodView& lodView = {}) const;
+  void drawPrepared(Shader& shader) const;
+
+  // Расстояние от lodView.position до ближайшего видимого экземпляра после
+  // prepareVisibleInstances. При отсечении на GPU видимые неизвестны, и это
+  // расстояние до объёма всех экземпляров (0, если камера внутри).
+  float getNearestDistance() const { return prepared.nearestDistance; }
+
+  const CullStats& getCullStats() const { return cullStats; }
+
+  // Отсекать экземпляры на GPU (nullptr — на CPU). Для неподвижных
+  // экземпляров: данные не покидают GPU, но результат отстаёт на кадр.
+  // В потоковом режиме и с импосторами используется отсечение на CPU.
+  void setGpuCulling(GpuCuller* culler);
+
+  // Дальше settings.distance рисовать экземпляры импосторами (nullptr —
+  // всегда мешем). Атлас запекается при первом рисовании после загрузки
+  // меша и текстуры.
+  void setImpostors(ImpostorRenderer* renderer,
+                    const ImpostorSettings& settings = {});
 
-  // Получить все экземпляры
-  const std::vector<ModelInstance*>& getInstances() const { return instances; }
+  // Вариант основного шейдера (биты ShaderFeature), которым рисуется модель
+  void setShaderFeatures(unsigned int features) { shaderFeatures = features; }
+  unsigned int getShaderFeatures() const { return shaderFeatures; }
 
-  // Нарисовать все экземпляры
-  void drawAllInstances() const;
+  // Брать текстуру из слоя массива (nullptr — своя GL_TEXTURE_2D). Вариант
+  // шейдера получает kShaderTextureArray. Без загруженной текстуры или
+  // без массива модель остаётся на своей текстуре; если массив её
+  // выгрузил, она загружается заново.
+  void setTextureArray(TextureArray* array);
+
+  // Что привязать к блоку 0 перед рисованием: массив или своя текстура
+  GLenum getTextureTarget() const {
+    return textureArray ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+  }
+  GLuint getDrawTexture() const {
+    return textureArray ? textureArray->getId() : texture;
+  }
+
+  static const UploadStats& getUploadStats() { return uploadStats; }
+  static void resetFrameUploadStats();
 
   // Деструктор
   ~Model();
 
  private:
-  // Буферы
-  GLuint VAO = 0, VBO = 0, EBO = 0;
+  // Общие ресурсы
+  std::shared_ptr<Mesh> mesh;
+  std::shared_ptr<Texture> textureHandle;
+  unsigned int shaderFeatures = 0;
+
+  // Массив текстур и слой в нём, если модель рисуется через массив
+  TextureArray* textureArray = nullptr;
+  int textureLayer = -1;
+
+  // Постоянный буфер экземпляров. VAO общий для всех мешей одного формата
+  // и принадлежит GeometryArena.
   mutable GLuint instanceVBO = 0;
-  size_t indexCount = 0;
 
-  // Экземпляры модели
-  std::vector<ModelInstance*> instances;
+  // Экземпляры модели. Плотный индекс экземпляра — его слот в буфере
+  // экземпляров.
+  mutable TransformPool transforms;
+
+  // Число слотов, под которые выделен буфер экземпляров
+  mutable size_t instanceCapacity = 0;
+
+  // Кольцевой буфер, если модель рисуется в потоковом режиме
+  std::unique_ptr<InstanceStream> instanceStream;
+
+  // Кольцевой буфер для видимых экземпляров, если модель рисуется
+  // не в потоковом режиме: постоянный буфер остаётся полной копией пула
+  mutable std::unique_ptr<InstanceStream> visibleStream;
 
-  // Буферы для матриц преобразований
-  mutable std::vector<glm::mat4> instanceMatrices;
-  mutable bool instanceBufferDirty = true;
+  // Плотные индексы экземпляров, рисуемых мешем после отсечения, их уровни
+  // детализации, доли импостора и число экземпляров на каждом уровне
+  mutable std::vector<uint32_t> visibleList;
+  mutable std::vector<uint8_t> visibleLods;
+  mutable std::vector<float> visibleFades;
+  mutable size_t lodCounts[kMaxLodLevels] = {};
+
+  // Импосторы: экземпляры на переходе есть и здесь, и в visibleList
+  ImpostorRenderer* impostorRenderer = nullptr;
+  ImpostorSettings impostorSettings;
+  mutable std::unique_ptr<ImpostorAtlas> impostorAtlas;
+  mutable std::vector<uint32_t> impostorList;
+  mutable std::vector<float> impostorFades;
+  mutable CullStats cullStats;
+
+  // Что prepareVisibleInstances оставил для drawPrepared
+  struct PreparedDraw {
+    enum class Mode { None, All, Visible, GpuCulled };
+    Mode mode = Mode::None;
+    // All: все экземпляры в buffer с байта offset
+    GLuint buffer = 0;
+    size_t offset = 0;
+    // Visible: экземпляры в кольце с байта offset по уровням, за ними
+    // импосторы
+    InstanceStream* stream = nullptr;
+    size_t lodStart[kMaxLodLevels] = {};
+    // GpuCulled: выход отсечения по уровням
+    GLuint gpuBuffers[kMaxLodLevels] = {};
+    size_t gpuCounts[kMaxLodLevels] = {};
+    float nearestDistance = 0.0f;
+    LodView lodView;
+  };
+  mutable PreparedDraw prepared;
+
+  // Отсечение на GPU
+  GpuCuller* gpuCuller = nullptr;
+  mutable std::unique_ptr<GpuCullBuffers> gpuCullBuffers;
+
+  // Параллелепипед всех экземпляров в мире, глубина модели в очереди при
+  // отсечении на GPU. Пересчитывается, когда меняются экземпляры или меш.
+  mutable Bounds instanceBounds;
+  mutable Bounds instanceBoundsSource;  // Объём меша, по которому считали
+  mutable size_t instanceBoundsCount = 0;
+  mutable bool instanceBoundsDirty = true;
+
+  static UploadStats uploadStats;
 
   // Приватные методы
-  bool checkFile(const std::string& filename);
-  bool load(const std::string& filename);
-  void setupBuffers();
-  void setupInstanceBuffer();
-  unsigned int addVertex(const ModelVertex& v);
-  bool createFallbackModel();
   void updateInstanceBuffer() const;
+  void streamInstances() const;
+  size_t cullInstances(const Frustum& frustum, const LodView& lodView) const;
+  bool updateImpostors() const;
+  void prepareAllInstances() const;
+  void prepareGpuCulled(const Frustum& frustum, const LodView& lodView) const;
+  Bounds getCullBounds() const;
+  void updateInstanceBounds(const Bounds& bounds) const;
+  void drawInstanced(size_t lod, size_t count, GLuint buffer,
+                     size_t offset) const;
 
   friend class ModelInstance;
 };
 
-// Экзмепляр модели
+// Экзмепляр модели: лёгкий дескриптор преобразования в пуле модели.
+// Копируется по значению; после destroy() все копии становятся
+// недействительными, и операции над ними ничего не делают.
 class ModelInstance {
  public:
-  ModelInstance(Model* parentModel);
-  ~ModelInstance();
+  ModelInstance() = default;
+
+  // Экземпляр существует
+  bool isValid() const {
+    return parentModel && parentModel->transforms.isValid(handle);
+  }
+  explicit operator bool() const { return isValid(); }
+
+  // Удалить экземпляр из модели
+  void destroy();
 
   // Преобразования
   void setPosition(const glm::vec3& position);
@@ -90,30 +255,25 @@ class ModelInstance {
   void setScale(const glm::vec3& scale);
 
   // Текущее преобразование модели
-  const glm::mat4& getTransform() const { return transform; }
-  const glm::vec3& getPosition() const { return position; }
-  const glm::vec3& getScale() const { return scale; }
-  float getRotationAngle() const { return rotationAngle; }
-  const glm::vec3& getRotationAxis() const { return rotationAxis; }
+  glm::mat4 getTransform() const;
+  glm::vec3 getPosition() const;
+  glm::vec3 getScale() const;
+  float getRotationAngle() const;
+  glm::vec3 getRotationAxis() const;
 
   // Операции над экзмепляром
   void translate(const glm::vec3& translation);
   void rotate(const glm::vec3& axis, float angleDegrees);
   void scaleBy(const glm::vec3& scaling);
 
-  // Обновить матрицу преобразований
-  void updateTransform();
-
  private:
-  Model* parentModel;
-  glm::mat4 transform;
+  Model* parentModel = nullptr;
+  TransformPool::Handle handle;
 
-  glm::vec3 position = glm::vec3(0.0f);
-  glm::vec3 scale = glm::vec3(1.0f);
-  glm::vec3 rotationAxis = glm::vec3(0.0f, 1.0f, 0.0f);
-  float rotationAngle = 0.0f;
+  ModelInstance(Model* parentModel, TransformPool::Handle handle)
+      : parentModel(parentModel), handle(handle) {}
 
-  void markInstanceBufferDirty();
+  friend class Model;
 };
 
 #endif  // MODEL_H
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "mesh_welder.h"
+#include "vertex.h"
+
+class ThreadPool;
+
+// Угол грани: индексы с нуля, -1 если компоненты нет
+struct ObjCorner {
+  int pos;
+  int tex;
+  int norm;
+};
+
+// Сырые данные obj-файла до склейки и триангуляции
+struct ObjData {
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec2> texCoords;
+  std::vector<glm::vec3> normals;
+  std::vector<ObjCorner> corners;    // Углы всех граней подряд
+  std::vector<uint32_t> faceSizes;   // Число углов в каждой грани
+
+  void clear();
+};
+
+// Разобрать текст obj-файла на месте, без копирования строк.
+// Поддерживаются записи v, vt, vn и f в формах v, v/vt, v/vt/vn, v//vn,
+// в том числе с отрицательными (относительными) индексами.
+// При ошибке возвращает false и описание в error.
+bool parseObj(const char* begin, const char* end, ObjData& out,
+              std::string& error);
+
+// То же, но файл режется на куски по границам строк, куски разбираются
+// на пуле потоков и сливаются с пересчётом относительных индексов.
+// chunks == 0 — по числу потоков пула. Небольшие файлы разбираются в
+// вызывающем потоке. Результат совпадает с parseObj.
+bool parseObjParallel(const char* begin, const char* end, ObjData& out,
+                      std::string& error, ThreadPool& pool,
+                      unsigned int chunks = 0);
+
+// Склеить углы граней в вершины и триангулировать грани веером.
+// Индексы углов проверяются на выход за границы массивов.
+bool buildObjMesh(const ObjData& obj, float weldEpsilon,
+                  std::vector<ModelVertex>& vertices,
+                  std::vector<unsigned int>& indices, WeldStats& stats,
+                  std::string& error);
+
+#endif  // OBJ_PARSER_H
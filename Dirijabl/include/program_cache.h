@@ -0,0 +1,89 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Заголовок файла .dprog, за ним — двоичная программа драйвера
+struct DProgHeader {
+  char magic[4];         // "DPRG"
+  uint32_t version;      // kDProgVersion
+  uint64_t key;          // Ключ программы, см. ProgramCache::makeKey
+  uint32_t binaryFormat; // Формат из glGetProgramBinary
+  uint32_t binarySize;
+  uint64_t payloadHash;  // FNV-1a двоичной программы
+};
+
+// Кэш слинкованных программ на диске (GL_ARB_get_program_binary).
+//
+// Программа хранится в shader_cache/<ключ>.dprog. Ключ — FNV-1a текстов
+// всех стадий (вместе с #version и #define варианта), производителя,
+// рендерера и версии драйвера, поэтому правка шейдера или обновление
+// драйвера просто дают новый ключ. Драйвер может отвергнуть и подходящую
+// по ключу программу; тогда файл удаляется, а программа собирается из
+// исходников заново.
+class ProgramCache {
+ public:
+  static constexpr uint32_t kDProgVersion = 1;
+
+  struct Stats {
+    size_t hits = 0;      // Программ, загруженных из кэша
+    size_t misses = 0;    // Файла нет или он не подошёл
+    size_t rejected = 0;  // Драйвер не принял двоичную программу
+    size_t stored = 0;    // Программ, записанных в кэш
+  };
+
+  // Стадия программы: тип и тексты, которые идут в glShaderSource подряд
+  struct Stage {
+    GLenum type;
+    std::vector<const char*> sources;
+  };
+
+  static ProgramCache& instance();
+
+  // Взять программу из кэша или собрать из стадий и записать в кэш, с
+  // выводом затраченного времени. Ключ — тексты всех стадий и keyExtras:
+  // то, что меняет программу помимо текстов (например, выходы transform
+  // feedback). beforeLink вызывается перед glLinkProgram. 0, если
+  // программа не собралась; ошибки выводятся в std::cerr.
+  GLuint build(const std::string& name, const std::vector<Stage>& stages,
+               const std::vector<const char*>& keyExtras = {},
+               const std::function<void(GLuint)>& beforeLink = {});
+
+  // Драйвер умеет отдавать и принимать двоичные программы
+  bool isSupported();
+
+  // Ключ программы по текстам стадий в том порядке, в котором они идут
+  // в glShaderSource
+  uint64_t makeKey(const char* const* sources, size_t count);
+
+  // Создать программу из кэша; 0, если кэша нет или драйвер его отверг
+  GLuint load(uint64_t key, const std::string& name);
+
+  // Попросить драйвер сохранить двоичную программу; до glLinkProgram
+  void prepare(GLuint program);
+
+  // Записать слинкованную программу в кэш
+  void store(uint64_t key, GLuint program);
+
+  const Stats& getStats() const { return stats; }
+
+ private:
+  ProgramCache() = default;
+
+  std::string cachePath(uint64_t key) const;
+  GLuint link(const std::string& name, const std::vector<Stage>& stages,
+              const std::function<void(GLuint)>& beforeLink);
+
+  int supported = -1;  // -1 — ещё не проверено
+  bool driverHashed = false;
+  uint64_t driverHash = 0;
+  Stats stats;
+};
+
+#endif  // PROGRAM_CACHE_H
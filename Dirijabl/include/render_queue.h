@@ -0,0 +1,79 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "frustum.h"
+
+class Model;
+class Shader;
+
+// Проходы кадра в порядке рисования
+enum class RenderPass : uint32_t {
+  Opaque = 0,      // Спереди назад, по состоянию
+  Transparent = 1  // Сзади вперёд, поверх непрозрачного
+};
+
+// Очередь рисования кадра. Модели отправляют в неё пакеты с 64-битным
+// ключом сортировки, а очередь раз в кадр сортирует их поразрядно и
+// рисует, переключая программу, текстуру и alpha только там, где они
+// действительно меняются.
+//
+// Ключ непрозрачного прохода, от старших битов к младшим:
+//   проход (2) | вариант программы (8) | текстура (16) | VAO арены (16) |
+//   глубина (22, ближние раньше)
+// Прозрачные пакеты сортируются прежде всего по глубине от дальних к
+// ближним, и только потом по состоянию:
+//   проход (2) | обратная глубина (22) | программа (8) | текстура (16) |
+//   VAO арены (16)
+//
+// Пакет — вся модель: у её уровней детализации одни программа, текстура и
+// VAO. Меши одного формата вершин и индексов лежат в общих буферах
+// GeometryArena и делят VAO, поэтому идут подряд без его смены. Отсечение
+// и заливка экземпляров делаются при отправке, поэтому к рисованию все
+// буферы экземпляров уже заполнены.
+class RenderQueue {
+ public:
+  // Что стоило рисование последнего кадра
+  struct Stats {
+    size_t packets = 0;
+    size_t drawCalls = 0;       // Мешей и импосторов по всем пакетам
+    size_t programChanges = 0;  // Переключений варианта шейдера
+    size_t textureChanges = 0;  // Привязок текстуры
+  };
+
+  // Начать кадр: очередь пустеет, статистика обнуляется
+  void begin();
+
+  // Отсечь экземпляры модели и поставить её в очередь. Модель без видимых
+  // экземпляров в очередь не попадает.
+  void submit(const Model& model, RenderPass pass, const Frustum& frustum,
+              const LodView& lodView, float alpha = 1.0f);
+
+  // Отсортировать пакеты и нарисовать их. Программа и текстура остаются
+  // привязанными после последнего пакета.
+  void execute(Shader& shader);
+
+  const Stats& getStats() const { return stats; }
+
+ private:
+  struct DrawPacket {
+    uint64_t key = 0;
+    const Model* model = nullptr;
+    float alpha = 1.0f;
+  };
+
+  std::vector<DrawPacket> packets;
+  std::vector<DrawPacket> scratch;  // Второй буфер поразрядной сортировки
+  Stats stats;
+
+  static uint64_t makeKey(RenderPass pass, unsigned int features,
+                          GLuint texture, GLuint mesh, float depth);
+  void sortPackets();
+};
+
+#endif  // RENDER_QUEUE_H
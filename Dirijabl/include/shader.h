@@ -6,23 +6,83 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <string>
 #include <iostream>
+#include <unordered_map>
 
+#include "frame_uniforms.h"
+
+// Features compiled into a variant of the scene program. A model without
+// any of them is static: no wind motion and no discard.
+enum ShaderFeature : unsigned int {
+    kShaderStatic = 0,
+    kShaderTreeSway = 1u << 0,      // Sway that grows with height
+    kShaderCloudDrift = 1u << 1,    // Slow horizontal and vertical drift
+    kShaderBalloonBob = 1u << 2,    // Vertical bobbing
+    kShaderAlphaTest = 1u << 3,     // Discard cut-out texels
+    kShaderImpostorFade = 1u << 4,  // Dithered cross-fade into impostors
+    kShaderTextureArray = 1u << 5,  // Sample a layer of a TextureArray
+};
+
+// Main scene program in variants specialized by ShaderFeature bits. All
+// variants are built from one source with a #define per feature, compiled
+// by prepare() or on first use and cached by their feature mask. Compiling
+// takes milliseconds, so variants should be prepared outside the frame.
+//
+// Camera, light and time come from the FrameData uniform block (see
+// FrameUniformBuffer); per-model uniforms go through the setters below and
+// apply to the current variant. Active uniform locations are looked up
+// once after linking, and a setter only reaches GL when the value actually
+// changes, so uniforms must not be set on a variant's program behind the
+// Shader's back. textureSampler always reads texture unit 0.
 class Shader {
 public:
-    GLuint programID;
-    
-    Shader();
+    Shader() = default;
     ~Shader();
+
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
     
-    void use() const;
+    // Make the variant with these features current
+    void use(unsigned int features = kShaderStatic);
+
+    // Build the variant with these features if it does not exist yet,
+    // keeping the current variant and program
+    void prepare(unsigned int features);
+
+    // Program of the current variant, 0 before the first use()
+    GLuint getProgram() const;
+    size_t getVariantCount() const { return variants.size(); }
     
     void setMat4(const std::string& name, const glm::mat4& mat) const;
     void setVec3(const std::string& name, const glm::vec3& vec) const;
     void setFloat(const std::string& name, float value) const;
     void setInt(const std::string& name, int value) const;
+
+    // Uploads that reached GL and ones skipped as unchanged
+    size_t getUniformUploads() const { return uniformUploads; }
+    size_t getUniformSkips() const { return uniformSkips; }
     
 private:
-    void checkCompileErrors(GLuint shader, const std::string& type);
+    struct Uniform {
+        GLint location = -1;
+        bool hasValue = false;
+        unsigned char value[sizeof(glm::mat4)];
+    };
+
+    struct Variant {
+        GLuint programID = 0;
+        std::unordered_map<std::string, Uniform> uniforms;
+    };
+
+    // Nodes of unordered_map never move, so current stays valid
+    std::unordered_map<unsigned int, Variant> variants;
+    Variant* current = nullptr;
+    mutable size_t uniformUploads = 0;
+    mutable size_t uniformSkips = 0;
+
+    void compileVariant(unsigned int features, Variant& variant);
+    void reflectUniforms(Variant& variant);
+    const Uniform* shadow(const std::string& name, const void* data,
+                          size_t size) const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,127 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <GL/glew.h>
+
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "texture_cache.h"
+
+// Изображение на CPU: декодированное в порядке строк файла (сверху вниз)
+// или готовая цепочка мип-уровней из <файл>.dtex. Читается без вызовов
+// OpenGL, поэтому может готовиться в рабочем потоке.
+struct TextureData {
+  sf::Image image;
+  bool ok = false;
+
+  // Если кэш актуален, уровни уходят в буфер распаковки прямо из
+  // отображённого файла, а image пуст
+  TextureCache cache;
+  bool cooked = false;
+
+  // Проверить файл и прочитать его кэш или декодировать изображение
+  bool read(const std::string& filename);
+
+  // Скопировать данные для буфера распаковки в dst: уровни кэша как есть
+  // или пиксели RGBA, начиная с нижней строки. OpenGL ждёт строки снизу
+  // вверх, и переворот совмещён с единственным копированием.
+  void copyTo(void* dst) const;
+
+  // Размер данных для буфера распаковки
+  size_t getByteSize() const;
+};
+
+// Внутренний формат OpenGL для сжатого формата .dtex
+GLenum compressedFormat(DTexFormat format);
+
+// Текстура в GPU. Одну текстуру делят все модели, которые её используют.
+//
+// Пиксели заливаются через буфер распаковки (PBO): главный поток отображает
+// буфер, строки копируются в него (в том числе из рабочего потока), после
+// чего glTexImage2D читает буфер асинхронно, а готовность отслеживается
+// по fence.
+class Texture {
+ public:
+  enum class Status {
+    Empty,      // Имя текстуры ещё не создано
+    Loading,    // Файл читается, показывается заглушка
+    Uploading,  // Команды заливки отправлены, GPU их ещё выполняет
+    Ready,      // Изображение из файла в GPU
+    Failed,     // Файл не прочитан, осталась заглушка
+    Unloaded    // Изображение выгружено, см. unload()
+  };
+
+  GLuint id = 0;
+
+  Texture() = default;
+  ~Texture();
+
+  Texture(const Texture&) = delete;
+  Texture& operator=(const Texture&) = delete;
+
+  // Загрузить текстуру из файла изображения. Заливка завершается в GPU
+  // позже, см. pollStatus().
+  bool load(const std::string& filename);
+
+  // Создать текстуру-заглушку 1x1 на время фоновой загрузки файла
+  void beginAsyncLoad(const std::string& filename);
+
+  // Отобразить буфер распаковки под изображение. Только из главного потока.
+  // В возвращённую память нужно записать data.copyTo() (из любого потока),
+  // затем вызвать finishUpload(). nullptr — заливка невозможна.
+  void* beginUpload(const TextureData& data);
+
+  // Отправить содержимое буфера в текстуру. Только из главного потока.
+  bool finishUpload();
+
+  // Залить изображение сразу, без отдельных шагов
+  bool apply(const TextureData& data);
+
+  // Отметить, что файл не удалось прочитать
+  void markFailed();
+
+  // Проверить fence заливки без ожидания. Только из главного потока.
+  Status pollStatus();
+
+  // Освободить память изображения, оставив вместо него белый пиксель.
+  // Имя текстуры не меняется, поэтому запомнившие его модели ничего не
+  // замечают. Загрузить заново — AssetRegistry::reloadTexture().
+  void unload();
+
+  Status getStatus() const { return status; }
+  bool isReady() const { return status == Status::Ready; }
+
+  // Размер в GPU вместе с мип-уровнями
+  size_t getByteSize() const { return byteSize; }
+
+  // Файл, из которого текстура загружается
+  const std::string& getFilename() const { return filename; }
+
+  // Формат и уровни последней заливки; уровни .dtex лежат в файле кэша
+  // по тем же смещениям
+  DTexFormat getFormat() const { return uploadFormat; }
+  const std::vector<DTexLevel>& getLevels() const { return uploadLevels; }
+
+ private:
+  Status status = Status::Empty;
+  size_t byteSize = 0;
+  std::string filename;
+
+  GLuint pbo = 0;
+  GLsync fence = nullptr;
+  bool mapped = false;
+  // Уровни, которые finishUpload() возьмёт из буфера распаковки. Для
+  // несжатого изображения — один уровень, остальные строит GPU.
+  DTexFormat uploadFormat = DTexFormat::RGBA8;
+  std::vector<DTexLevel> uploadLevels;
+  bool generateMipmaps = false;
+
+  void create();
+  void setPlaceholder();
+  void releaseStaging();
+};
+
+#endif  // TEXTURE_H
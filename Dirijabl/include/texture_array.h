@@ -0,0 +1,105 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "texture.h"
+
+// Номер вершинного атрибута со слоем массива текстур (instanceLayer
+// основного шейдера). Слой общий для всех экземпляров модели, поэтому
+// массив атрибута выключен, а значение задаётся glVertexAttrib1f перед
+// рисованием.
+constexpr GLuint kTextureLayerAttribute = 8;
+
+// Текстуры моделей, собранные в один GL_TEXTURE_2D_ARRAY: модели с разными
+// текстурами рисуются без перепривязки, меняется только номер слоя.
+//
+// Пока текстуры грузятся, слои RGBA8 со стороной kLayerSize: текстура
+// перерисовывается в свой слой полноэкранным треугольником с линейной
+// фильтрацией, а мип-уровни массива строит GPU. Слой с заглушкой
+// перерисовывается, когда загрузка закончится.
+//
+// Когда загружены все текстуры, массив заполнен окончательно. Если все они
+// из .dtex одного сжатого формата и размера, массив пересоздаётся в этом
+// формате, и уровни заливаются прямо из файлов кэша. После этого исходные
+// текстуры выгружаются: модели рисуют из массива, импосторы запекаются из
+// слоя, а модель, ушедшая с массива, загружает свою текстуру заново.
+class TextureArray {
+ public:
+  // Сторона слоя RGBA8
+  static constexpr GLsizei kLayerSize = 1024;
+
+  TextureArray();
+  ~TextureArray();
+
+  TextureArray(const TextureArray&) = delete;
+  TextureArray& operator=(const TextureArray&) = delete;
+
+  // Программа копирования собралась
+  bool isValid() const { return program != 0; }
+
+  // Слой для текстуры; повторный вызов с той же текстурой возвращает тот же
+  // слой. -1, если массив недоступен.
+  int addTexture(const std::shared_ptr<Texture>& texture);
+
+  // Заполнить слои, чьи текстуры загрузились с прошлого раза, и выгрузить
+  // исходные текстуры, когда массив готов. Вызывается раз в кадр до
+  // рисования, пока модели рисуют из массива; состояние OpenGL сохраняется.
+  void update();
+
+  // Все слои заполнены окончательно, исходные текстуры выгружаются
+  bool isComplete() const { return complete; }
+
+  GLuint getId() const { return id; }
+  size_t getLayerCount() const { return layers.size(); }
+
+  // Размер в GPU вместе с мип-уровнями
+  size_t getByteSize() const { return layerBytes * capacity; }
+
+  // Вывести число, размер и формат слоёв и занятую массивом память
+  void printStats() const;
+
+ private:
+  struct Layer {
+    std::shared_ptr<Texture> texture;
+    bool filled = false;
+    Texture::Status filledStatus = Texture::Status::Empty;
+  };
+
+  GLint maxLayerSize = 1;
+  GLsizei layerWidth = 0;
+  GLsizei layerHeight = 0;
+  GLsizei levels = 0;
+  DTexFormat format = DTexFormat::RGBA8;
+  size_t layerBytes = 0;  // Один слой со всеми мип-уровнями
+  GLuint id = 0;
+  size_t capacity = 0;  // Слоёв выделено в GPU
+  std::vector<Layer> layers;
+  bool complete = false;
+  bool compressible = true;  // Сжатые слои ещё не отказали
+
+  GLuint program = 0;
+  GLuint framebuffer = 0;
+  GLuint vao = 0;  // Пустой: вершины треугольника из gl_VertexID
+
+  // Пересоздать массив RGBA8; все слои заполнятся заново
+  void allocate(size_t layerCount);
+
+  // Перерисовать слои из исходных текстур
+  void copyLayers(const std::vector<size_t>& dirty);
+
+  // Все текстуры — загруженные .dtex одного сжатого формата и размера
+  bool canCompress() const;
+
+  // Пересоздать массив в сжатом формате и залить уровни из .dtex. false,
+  // если кэш какой-то текстуры не открылся или не совпал с ней.
+  bool uploadCompressed();
+
+  void setSampling() const;
+};
+
+#endif  // TEXTURE_ARRAY_H
@@ -0,0 +1,81 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+// Формат пикселей в .dtex
+enum class DTexFormat : uint32_t {
+  RGBA8 = 0,  // Без сжатия, 4 байта на пиксель
+  BC1 = 1,    // S3TC DXT1, 8 байт на блок 4x4, без прозрачности
+  BC3 = 2     // S3TC DXT5, 16 байт на блок 4x4, с альфа-каналом
+};
+
+// Название формата для сообщений
+const char* dtexFormatName(DTexFormat format);
+
+// Заголовок файла .dtex. За ним лежит таблица уровней DTexLevel[mipCount],
+// а за таблицей — данные уровней подряд, строки снизу вверх, как их ждёт
+// OpenGL.
+struct DTexHeader {
+  char magic[4];         // "DTEX"
+  uint32_t version;      // kDTexVersion
+  uint32_t format;       // DTexFormat
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipCount;
+  uint64_t sourceSize;   // Размер исходного изображения
+  int64_t sourceMtime;   // Время изменения исходного изображения
+  uint64_t sourceHash;   // FNV-1a содержимого исходного изображения
+  uint64_t payloadHash;  // FNV-1a данных всех уровней
+};
+
+// Один мип-уровень в .dtex
+struct DTexLevel {
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;  // Смещение от начала данных уровней
+  uint64_t size;
+};
+
+// Подготовленная текстура с готовой цепочкой мип-уровней, сохранённая рядом
+// с исходным изображением. Актуальность проверяется так же, как у .dmesh.
+class TextureCache {
+ public:
+  static constexpr uint32_t kDTexVersion = 1;
+
+  // Путь к кэшу для изображения
+  static std::string cachePath(const std::string& imagePath);
+
+  // Отобразить кэш в память; false, если его нет или он устарел
+  bool open(const std::string& imagePath);
+  void close();
+
+  // Записать кэш для изображения
+  static bool write(const std::string& imagePath, DTexFormat format,
+                    uint32_t width, uint32_t height,
+                    const std::vector<DTexLevel>& levels,
+                    const std::vector<uint8_t>& payload);
+
+  bool isOpen() const { return header != nullptr; }
+  DTexFormat getFormat() const;
+  uint32_t getWidth() const { return header ? header->width : 0; }
+  uint32_t getHeight() const { return header ? header->height : 0; }
+  uint32_t getMipCount() const { return header ? header->mipCount : 0; }
+  const DTexLevel& getLevel(uint32_t level) const { return levels[level]; }
+  const uint8_t* getPayload() const { return payload; }
+  size_t getPayloadSize() const { return payloadSize; }
+
+ private:
+  MappedFile file;
+  const DTexHeader* header = nullptr;
+  const DTexLevel* levels = nullptr;
+  const uint8_t* payload = nullptr;
+  size_t payloadSize = 0;
+};
+
+#endif  // TEXTURE_CACHE_H
@@ -0,0 +1,29 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "texture_cache.h"
+
+// Сжать блок 4x4 пикселей RGBA (64 байта, строка за строкой) в BC1
+void encodeBC1Block(const uint8_t* rgba, uint8_t* out);
+
+// Сжать блок 4x4 пикселей RGBA в BC3: альфа-блок и цветовой блок BC1
+void encodeBC3Block(const uint8_t* rgba, uint8_t* out);
+
+// Размер уровня в байтах для формата
+size_t levelByteSize(DTexFormat format, uint32_t width, uint32_t height);
+
+// Все пиксели непрозрачны, и альфа-канал можно не хранить
+bool isOpaque(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+// Построить цепочку мип-уровней до 1x1 и сжать каждый уровень.
+// rgba — изображение в порядке строк файла (сверху вниз); в результат
+// уровни попадают снизу вверх, как их ждёт glTexImage2D.
+void cookTexture(const uint8_t* rgba, uint32_t width, uint32_t height,
+                 DTexFormat format, std::vector<DTexLevel>& levels,
+                 std::vector<uint8_t>& payload);
+
+#endif  // TEXTURE_COOKER_H
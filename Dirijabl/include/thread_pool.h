@@ -0,0 +1,59 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул рабочих потоков с общей очередью задач
+class ThreadPool {
+ public:
+  // threadCount == 0 — по числу ядер
+  explicit ThreadPool(unsigned int threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Поставить задачу в очередь
+  template <typename F>
+  std::future<void> submit(F&& task) {
+    auto packaged =
+        std::make_shared<std::packaged_task<void()>>(std::forward<F>(task));
+    std::future<void> result = packaged->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.emplace_back([packaged]() { (*packaged)(); });
+    }
+    wakeup.notify_one();
+    return result;
+  }
+
+  // Дождаться задачи, выполняя в ожидании задачи из очереди.
+  // Так задача пула может ждать свои подзадачи без взаимной блокировки.
+  void wait(std::future<void>& future);
+
+  unsigned int getThreadCount() const {
+    return static_cast<unsigned int>(workers.size());
+  }
+
+  // Общий пул на все ядра
+  static ThreadPool& shared();
+
+ private:
+  bool runPendingTask();
+  void workerLoop();
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  bool stopping = false;
+};
+
+#endif  // THREAD_POOL_H
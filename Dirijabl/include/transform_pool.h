@@ -0,0 +1,107 @@
+#ifndef TRANSFORM_POOL_H
+#define TRANSFORM_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+#include "vertex.h"
+
+// Собрать матрицы T * R * S и множители нормалей для count экземпляров из
+// подряд лежащих массивов. Поворот — единичный кватернион. На x86 четыре
+// экземпляра собираются за раз на SSE, остаток — скалярно.
+void composeTransforms(const glm::vec3* positions, const glm::quat* rotations,
+                       const glm::vec3* scales, InstanceTransform* out,
+                       size_t count);
+
+// Плотное хранилище преобразований экземпляров в виде структуры массивов.
+//
+// Живые экземпляры лежат подряд в массивах позиций, поворотов, масштабов и
+// матриц; индекс в них (плотный индекс) совпадает со слотом в буфере
+// экземпляров. Снаружи экземпляр адресуется дескриптором: номер ячейки в
+// разреженной таблице и её поколение. Удаление переносит последний элемент
+// на место удалённого, ячейка уходит в список свободных, а поколение растёт,
+// так что старый дескриптор перестаёт быть действительным.
+//
+// Сеттеры только записывают параметры (поворот сразу переводится в
+// кватернион); матрицы пересчитываются пачкой в updateMatrices():
+// изменённые индексы сортируются, и каждая непрерывная серия собирается
+// composeTransforms().
+class TransformPool {
+ public:
+  static constexpr uint32_t kInvalid = 0xffffffffu;
+
+  struct Handle {
+    uint32_t index = kInvalid;
+    uint32_t generation = 0;
+  };
+
+  // Добавить экземпляр с единичным преобразованием
+  Handle create();
+
+  // Удалить экземпляр; false, если дескриптор уже недействителен
+  bool remove(Handle handle);
+
+  bool isValid(Handle handle) const { return denseIndex(handle) != kInvalid; }
+  size_t size() const { return positions.size(); }
+  void reserve(size_t count);
+
+  // Параметры экземпляра. Недействительный дескриптор игнорируется.
+  void setPosition(Handle handle, const glm::vec3& position);
+  void setRotation(Handle handle, const glm::vec3& axis, float angleDegrees);
+  void setScale(Handle handle, const glm::vec3& scale);
+  void translate(Handle handle, const glm::vec3& translation);
+  void rotate(Handle handle, const glm::vec3& axis, float angleDegrees);
+  void scaleBy(Handle handle, const glm::vec3& scaling);
+
+  glm::vec3 getPosition(Handle handle) const;
+  glm::vec3 getScale(Handle handle) const;
+  glm::vec3 getRotationAxis(Handle handle) const;
+  float getRotationAngle(Handle handle) const;
+
+  // Матрица экземпляра; пересчитывается, если параметры менялись
+  glm::mat4 getMatrix(Handle handle) const;
+
+  // Пересчитать все изменённые матрицы
+  void updateMatrices();
+
+  // Данные экземпляров по плотным индексам; актуальны после
+  // updateMatrices()
+  const InstanceTransform* getInstanceTransforms() const {
+    return instanceTransforms.data();
+  }
+
+  // Плотные индексы, чьи матрицы изменились или переехали с последней
+  // заливки. Могут повторяться и выходить за size() после удалений.
+  std::vector<uint32_t>& getUploadList() { return uploadList; }
+  void clearUploadList();
+
+ private:
+  enum : uint8_t { kMatrixPending = 1, kUploadPending = 2 };
+
+  // Плотные массивы
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> rotationAxes;
+  std::vector<float> rotationAngles;
+  std::vector<glm::quat> rotations;
+  std::vector<glm::vec3> scales;
+  std::vector<InstanceTransform> instanceTransforms;
+  std::vector<uint32_t> denseToIndex;
+  std::vector<uint8_t> flags;
+
+  // Разреженная таблица дескрипторов
+  std::vector<uint32_t> indexToDense;
+  std::vector<uint32_t> generations;
+  std::vector<uint32_t> freeIndices;
+
+  std::vector<uint32_t> matrixList;
+  std::vector<uint32_t> uploadList;
+
+  uint32_t denseIndex(Handle handle) const;
+  void mark(uint32_t dense, uint8_t bits);
+  void updateRotation(uint32_t dense);
+};
+
+#endif  // TRANSFORM_POOL_H
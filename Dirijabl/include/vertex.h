@@ -0,0 +1,41 @@
+#ifndef VERTEX_H
+#define VERTEX_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Вершина меша на CPU и в несжатом VBO
+struct ModelVertex {
+  glm::vec3 position;
+  glm::vec2 texCoord;
+  glm::vec3 normal;
+
+  bool operator==(const ModelVertex& other) const {
+    return position == other.position && texCoord == other.texCoord &&
+           normal == other.normal;
+  }
+};
+
+// Сжатая вершина в VBO: 16 байт вместо 32.
+// Позиция — 16-битные доли ограничивающего параллелепипеда меша
+// (GL_UNSIGNED_SHORT, нормализованные), шейдер восстанавливает её как
+// offset + position * scale. Нормаль — 10:10:10:2 со знаком
+// (GL_INT_2_10_10_10_REV), текстурные координаты — half float.
+struct PackedVertex {
+  uint16_t position[4];  // w — выравнивание
+  uint32_t normal;
+  uint16_t texCoord[2];
+};
+
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex must stay 16 bytes");
+
+// Данные экземпляра в том виде, в котором они лежат в буфере экземпляров.
+// Матрица нормалей для T * R * S равна R * S^-1 = mat3(model) * S^-2, поэтому
+// вместо неё хранится только множитель 1 / scale^2. В w — доля импостора
+// на переходе к нему (в TransformPool всегда 0).
+struct InstanceTransform {
+  glm::mat4 model;
+  glm::vec4 normalScale;
+};
+
+#endif  // VERTEX_H
@@ -0,0 +1,35 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "frustum.h"
+#include "vertex.h"
+
+// Как шейдер восстанавливает позицию сжатой вершины: offset + p * scale,
+// где p — нормализованные 16 бит из PackedVertex. Для несжатых вершин
+// преобразование тождественное.
+struct PositionDecode {
+  glm::vec3 offset = glm::vec3(0.0f);
+  glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// Квантование позиций по ограничивающему параллелепипеду меша: шаг по
+// каждой оси — 1/65535 его размера
+PositionDecode makePositionDecode(const Bounds& bounds);
+
+// Число с плавающей точкой в half float с округлением к ближайшему чётному
+uint16_t floatToHalf(float value);
+
+// Нормаль в 10:10:10:2 со знаком, w = 0
+uint32_t packNormal(const glm::vec3& normal);
+
+// Сжать вершины для заливки в VBO
+void packVertices(const ModelVertex* vertices, size_t count,
+                  const PositionDecode& decode,
+                  std::vector<PackedVertex>& packed);
+
+#endif  // VERTEX_PACKING_H
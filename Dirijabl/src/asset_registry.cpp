@@ -0,0 +1,108 @@
+#include "asset_registry.h"
+
+#include <sstream>
+
+#include "async_loader.h"
+
+AssetRegistry& AssetRegistry::instance() {
+  static AssetRegistry registry;
+  return registry;
+}
+
+std::shared_ptr<Mesh> AssetRegistry::acquireMesh(
+    const std::string& filename, const ModelLoadOptions& options) {
+  // Меши с разной склейкой вершин, числом уровней или форматом вершин —
+  // разные ресурсы
+  std::string key = filename;
+  if (options.weldEpsilon > 0.0f || options.lodLevels != kDefaultLodLevels ||
+      !options.packVertices) {
+    std::ostringstream oss;
+    oss << filename << "#weld=" << options.weldEpsilon
+        << "#lods=" << options.lodLevels
+        << "#packed=" << options.packVertices;
+    key = oss.str();
+  }
+
+  auto it = meshes.find(key);
+  if (it != meshes.end()) {
+    if (auto mesh = it->second.lock()) {
+      stats.meshHits++;
+      std::cout << "Меш из реестра: " << filename << std::endl;
+      return mesh;
+    }
+  }
+
+  auto mesh = std::make_shared<Mesh>();
+  if (asyncLoading) {
+    if (mesh->beginAsyncLoad(filename, options)) {
+      AsyncLoader::instance().loadMesh(mesh, filename, options);
+    }
+  } else {
+    mesh->load(filename, options);
+  }
+  meshes[key] = mesh;
+  stats.meshLoads++;
+  return mesh;
+}
+
+std::shared_ptr<Texture> AssetRegistry::acquireTexture(
+    const std::string& filename) {
+  auto it = textures.find(filename);
+  if (it != textures.end()) {
+    if (auto texture = it->second.lock()) {
+      stats.textureHits++;
+      std::cout << "Текстура из реестра: " << filename << std::endl;
+      return texture;
+    }
+  }
+
+  auto texture = std::make_shared<Texture>();
+  if (asyncLoading) {
+    texture->beginAsyncLoad(filename);
+    AsyncLoader::instance().loadTexture(texture, filename);
+  } else {
+    texture->load(filename);
+  }
+  textures[filename] = texture;
+  stats.textureLoads++;
+  return texture;
+}
+
+void AssetRegistry::reloadTexture(const std::shared_ptr<Texture>& texture) {
+  if (!texture || texture->getStatus() != Texture::Status::Unloaded) return;
+
+  const std::string filename = texture->getFilename();
+  if (asyncLoading) {
+    texture->beginAsyncLoad(filename);
+    AsyncLoader::instance().loadTexture(texture, filename);
+  } else {
+    texture->load(filename);
+  }
+  stats.textureLoads++;
+}
+
+void AssetRegistry::printStats() const {
+  size_t liveMeshes = 0, meshBytes = 0;
+  for (const auto& [key, weak] : meshes) {
+    if (auto mesh = weak.lock()) {
+      liveMeshes++;
+      meshBytes += mesh->getGpuBytes();
+    }
+  }
+
+  size_t liveTextures = 0, textureBytes = 0;
+  for (const auto& [key, weak] : textures) {
+    if (auto texture = weak.lock()) {
+      liveTextures++;
+      textureBytes += texture->getByteSize();
+    }
+  }
+
+  std::cout << "Реестр ресурсов: мешей " << liveMeshes << " ("
+            << meshBytes / 1024 << " КБ, загрузок " << stats.meshLoads
+            << ", повторных запросов " << stats.meshHits << "), текстур "
+            << liveTextures << " (" << textureBytes / 1024
+            << " КБ, загрузок " << stats.textureLoads
+            << ", повторных запросов " << stats.textureHits << ")"
+            << std::endl;
+}
@@ -0,0 +1,138 @@
+#include "async_loader.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+// Потоков немного: чтение упирается в диск, а разбор больших obj
+// сам распределяется по общему пулу
+constexpr unsigned int kLoaderThreads = 2;
+
+}  // namespace
+
+AsyncLoader& AsyncLoader::instance() {
+  static AsyncLoader loader;
+  return loader;
+}
+
+AsyncLoader::AsyncLoader()
+    : shared(ThreadPool::shared()), pool(kLoaderThreads) {}
+
+AsyncLoader::~AsyncLoader() {
+  // Задачи, которые ещё не начались, завершатся сразу
+  cancelled = true;
+}
+
+void AsyncLoader::loadMesh(const std::shared_ptr<Mesh>& mesh,
+                           const std::string& filename,
+                           const ModelLoadOptions& options) {
+  std::weak_ptr<Mesh> target = mesh;
+  pending++;
+
+  pool.submit([this, target, filename, options]() {
+    if (cancelled || target.expired()) {
+      pending--;
+      return;
+    }
+
+    auto data = std::make_shared<MeshData>();
+    data->read(filename, options);
+
+    completed.push([this, target, data]() {
+      auto mesh = target.lock();
+      if (mesh && !cancelled) {
+        mesh->apply(*data);
+      }
+      pending--;
+    });
+  });
+}
+
+void AsyncLoader::loadTexture(const std::shared_ptr<Texture>& texture,
+                              const std::string& filename) {
+  std::weak_ptr<Texture> target = texture;
+  pending++;
+
+  pool.submit([this, target, filename]() {
+    if (cancelled || target.expired()) {
+      pending--;
+      return;
+    }
+
+    auto data = std::make_shared<TextureData>();
+    data->read(filename);
+
+    completed.push([this, target, data, filename]() {
+      auto texture = target.lock();
+      if (!texture) {
+        pending--;
+        return;
+      }
+      if (!data->ok || cancelled) {
+        texture->markFailed();
+        pending--;
+        return;
+      }
+      finishTextureUpload(texture, data, filename);
+    });
+  });
+}
+
+void AsyncLoader::finishTextureUpload(
+    const std::shared_ptr<Texture>& texture,
+    const std::shared_ptr<TextureData>& data, const std::string& filename) {
+  void* staging = texture->beginUpload(*data);
+  if (!staging) {
+    texture->markFailed();
+    pending--;
+    return;
+  }
+
+  // Пока буфер отображён, задача держит текстуру, чтобы он не был удалён
+  // во время записи
+  pool.submit([this, texture, data, staging, filename]() {
+    data->copyTo(staging);
+
+    completed.push([this, texture, filename]() {
+      if (texture->finishUpload()) {
+        std::cout << "Текстура отправлена в GPU: " << filename << std::endl;
+        uploading.push_back(texture);
+      } else {
+        pending--;
+      }
+    });
+  });
+}
+
+size_t AsyncLoader::processUploads() {
+  size_t processed =
+      completed.drain([](std::function<void()>& upload) { upload(); });
+
+  // Заливка текстур завершается на GPU за один или несколько кадров
+  for (size_t i = 0; i < uploading.size();) {
+    auto texture = uploading[i].lock();
+    if (texture && texture->pollStatus() == Texture::Status::Uploading) {
+      i++;
+      continue;
+    }
+    uploading[i] = uploading.back();
+    uploading.pop_back();
+    pending--;
+  }
+  return processed;
+}
+
+void AsyncLoader::shutdown() {
+  cancelled = true;
+
+  // Задачи, которые уже идут, досчитываются, а их результаты
+  // отбрасываются или завершаются здесь, пока есть контекст OpenGL
+  while (pending > uploading.size()) {
+    if (processUploads() == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  pending -= uploading.size();
+  uploading.clear();
+}
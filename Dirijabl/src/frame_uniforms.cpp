@@ -0,0 +1,23 @@
+#include "frame_uniforms.h"
+
+FrameUniformBuffer::FrameUniformBuffer() {
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+FrameUniformBuffer::~FrameUniformBuffer() {
+  if (buffer != 0) glDeleteBuffers(1, &buffer);
+}
+
+void FrameUniformBuffer::update(const FrameUniforms& data) {
+  // Буфер целиком переписывается каждый кадр: glBufferData отдаёт драйверу
+  // новую память, и ждать кадр, который ещё читает старую, не нужно
+  glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), &data,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, kFrameUniformBinding, buffer);
+}
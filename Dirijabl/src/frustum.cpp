@@ -0,0 +1,77 @@
+#include "frustum.h"
+
+#include <algorithm>
+#include <cmath>
+
+Bounds Bounds::fromVertices(const ModelVertex* vertices, size_t count) {
+  Bounds bounds;
+  if (count == 0) return bounds;
+
+  bounds.min = bounds.max = vertices[0].position;
+  for (size_t i = 1; i < count; i++) {
+    bounds.min = glm::min(bounds.min, vertices[i].position);
+    bounds.max = glm::max(bounds.max, vertices[i].position);
+  }
+
+  // Сфера вокруг центра AABB: радиус — до самой дальней вершины, а не
+  // половина диагонали, так она обычно заметно плотнее
+  bounds.center = (bounds.min + bounds.max) * 0.5f;
+  float radiusSquared = 0.0f;
+  for (size_t i = 0; i < count; i++) {
+    glm::vec3 d = vertices[i].position - bounds.center;
+    radiusSquared = std::max(radiusSquared, glm::dot(d, d));
+  }
+  bounds.radius = std::sqrt(radiusSquared);
+  return bounds;
+}
+
+Frustum::Frustum(const glm::mat4& viewProjection) {
+  // Строки матрицы (glm хранит столбцы)
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++) {
+    rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i],
+                        viewProjection[2][i], viewProjection[3][i]);
+  }
+
+  planes[0] = rows[3] + rows[0];  // Левая
+  planes[1] = rows[3] - rows[0];  // Правая
+  planes[2] = rows[3] + rows[1];  // Нижняя
+  planes[3] = rows[3] - rows[1];  // Верхняя
+  planes[4] = rows[3] + rows[2];  // Ближняя
+  planes[5] = rows[3] - rows[2];  // Дальняя
+
+  for (glm::vec4& plane : planes) {
+    float length = glm::length(glm::vec3(plane));
+    if (length > 0.0f) plane = plane / length;
+  }
+}
+
+Frustum::Result Frustum::testSphere(const glm::vec3& center,
+                                    float radius) const {
+  Result result = Result::Inside;
+  for (const glm::vec4& plane : planes) {
+    float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+    if (distance < -radius) return Result::Outside;
+    if (distance < radius) result = Result::Intersects;
+  }
+  return result;
+}
+
+bool Frustum::intersectsBox(const Bounds& bounds,
+                            const glm::mat4& model) const {
+  // Центр и полуразмеры описанного мирового AABB
+  glm::vec3 localExtent = (bounds.max - bounds.min) * 0.5f;
+  glm::vec3 center = glm::vec3(model * glm::vec4(bounds.center, 1.0f));
+  glm::vec3 extent(0.0f);
+  for (int c = 0; c < 3; c++) {
+    extent += glm::abs(glm::vec3(model[c])) * localExtent[c];
+  }
+
+  for (const glm::vec4& plane : planes) {
+    glm::vec3 normal(plane);
+    float distance = glm::dot(normal, center) + plane.w;
+    float reach = glm::dot(glm::abs(normal), extent);
+    if (distance < -reach) return false;
+  }
+  return true;
+}
@@ -0,0 +1,373 @@
+#include "geometry_arena.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+#include <iterator>
+
+#include "vertex.h"
+
+namespace {
+
+// Начальная ёмкость пулов: хватает на несколько средних мешей
+constexpr size_t kMinPoolVertices = 65536;
+constexpr size_t kMinPoolIndices = 3 * 65536;
+
+// Пул уплотняется, когда дыры занимают больше этой доли занятого и больше
+// такой же доли наименьшего пула: мелкие дыры не стоят копирования
+constexpr size_t kCompactDivisor = 4;  // 25 %
+
+}  // namespace
+
+float GeometryArena::PoolStats::fragmentation() const {
+  // Хвост за границей — тоже свободное место одним куском
+  const size_t freeBytes = capacity - used;
+  if (freeBytes == 0) return 0.0f;
+  return 1.0f - static_cast<float>(largestFree) /
+                    static_cast<float>(freeBytes);
+}
+
+GeometryArena& GeometryArena::instance() {
+  static GeometryArena arena;
+  return arena;
+}
+
+GeometryArena::GeometryArena() {
+  vertexPools[0].unit = sizeof(PackedVertex);
+  vertexPools[1].unit = sizeof(ModelVertex);
+  indexPools[0].unit = sizeof(GLushort);
+  indexPools[1].unit = sizeof(GLuint);
+  for (Pool& pool : vertexPools) pool.minCapacity = kMinPoolVertices;
+  for (Pool& pool : indexPools) pool.minCapacity = kMinPoolIndices;
+}
+
+GeometryArena::Handle GeometryArena::allocate(bool packed, bool shortIndices,
+                                              const void* vertices,
+                                              size_t vertexCount,
+                                              const void* indices,
+                                              size_t indexCount) {
+  if (vertexCount == 0 || indexCount == 0) return kInvalidHandle;
+
+  const unsigned int vertexPool = packed ? 0 : 1;
+  const unsigned int indexPool = shortIndices ? 0 : 1;
+  Pool& vertexData = vertexPools[vertexPool];
+  Pool& indexData = indexPools[indexPool];
+
+  Range range;
+  range.layout = vertexPool * 2 + indexPool;
+  range.vertexOffset = allocateIn(vertexData, vertexCount);
+  range.vertexCount = vertexCount;
+  range.indexOffset = allocateIn(indexData, indexCount);
+  range.indexCount = indexCount;
+
+  // Привязка GL_ELEMENT_ARRAY_BUFFER — состояние VAO, поэтому данные
+  // заливаются через нейтральную точку привязки
+  glBindBuffer(GL_COPY_WRITE_BUFFER, vertexData.buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, range.vertexOffset * vertexData.unit,
+                  vertexCount * vertexData.unit, vertices);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, indexData.buffer);
+  glBufferSubData(GL_COPY_WRITE_BUFFER, range.indexOffset * indexData.unit,
+                  indexCount * indexData.unit, indices);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  Handle handle;
+  if (!freeHandles.empty()) {
+    handle = freeHandles.back();
+    freeHandles.pop_back();
+    ranges[handle] = range;
+    live[handle] = true;
+  } else {
+    handle = static_cast<Handle>(ranges.size());
+    ranges.push_back(range);
+    live.push_back(true);
+  }
+  return handle;
+}
+
+void GeometryArena::release(Handle handle) {
+  if (handle >= ranges.size() || !live[handle]) return;
+
+  const Range& range = ranges[handle];
+  Pool& vertexData = vertexPools[range.layout / 2];
+  Pool& indexData = indexPools[range.layout % 2];
+  releaseIn(vertexData, range.vertexOffset, range.vertexCount);
+  releaseIn(indexData, range.indexOffset, range.indexCount);
+  live[handle] = false;
+  freeHandles.push_back(handle);
+
+  // Дыры, в которые новые меши не помещаются, только раздувают буфер
+  for (Pool* pool : {&vertexData, &indexData}) {
+    const size_t holes = pool->top - pool->used;
+    if (holes > pool->top / kCompactDivisor &&
+        holes > pool->minCapacity / kCompactDivisor) {
+      compact(*pool, pool == &vertexData);
+    }
+  }
+}
+
+GLuint GeometryArena::getVertexArray(Handle handle) const {
+  return arrays[ranges[handle].layout].vao;
+}
+
+void GeometryArena::bind(Handle handle, GLuint buffer, size_t offset) {
+  VertexArray& array = arrays[ranges[handle].layout];
+  if (array.vao == 0) {
+    glGenVertexArrays(1, &array.vao);
+    glBindVertexArray(array.vao);
+    // 4 вектора vec4 в качестве mat4 и множитель нормалей, по одному
+    // на экземпляр
+    for (GLuint i = 3; i < 8; i++) {
+      glEnableVertexAttribArray(i);
+      glVertexAttribDivisor(i, 1);
+    }
+  } else {
+    glBindVertexArray(array.vao);
+  }
+  if (array.dirty) {
+    setupVertexAttributes(ranges[handle].layout);
+    array.dirty = false;
+  }
+
+  // Каждая модель и каждый уровень читают свой участок буфера
+  // экземпляров, поэтому указатели меняются при каждом рисовании
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  for (GLuint i = 0; i < 5; i++) {
+    glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE,
+                          sizeof(InstanceTransform),
+                          (void*)(offset + i * sizeof(glm::vec4)));
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::setupAttributes(Handle handle) const {
+  setupVertexAttributes(ranges[handle].layout);
+}
+
+void GeometryArena::setupVertexAttributes(unsigned int layout) const {
+  const bool packed = layout / 2 == 0;
+  glBindBuffer(GL_ARRAY_BUFFER, vertexPools[layout / 2].buffer);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexPools[layout % 2].buffer);
+
+  // Смещения от начала пула: первую вершину меша задаёт base vertex
+  if (packed) {
+    // Позиции: доли параллелепипеда, шейдер переводит их обратно
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+                          sizeof(PackedVertex),
+                          (void*)offsetof(PackedVertex, position));
+    // Текстурные координаты
+    glVertexAttribPointer(1, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex),
+                          (void*)offsetof(PackedVertex, texCoord));
+    // Нормали; четвёртая компонента шейдеру не нужна
+    glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE,
+                          sizeof(PackedVertex),
+                          (void*)offsetof(PackedVertex, normal));
+  } else {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ModelVertex),
+                          (void*)offsetof(ModelVertex, position));
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ModelVertex),
+                          (void*)offsetof(ModelVertex, texCoord));
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(ModelVertex),
+                          (void*)offsetof(ModelVertex, normal));
+  }
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+size_t GeometryArena::allocateIn(Pool& pool, size_t count) {
+  // Самый маленький подходящий свободный блок, чтобы крупные оставались
+  // для крупных мешей
+  auto best = pool.freeBlocks.end();
+  for (auto it = pool.freeBlocks.begin(); it != pool.freeBlocks.end(); ++it) {
+    if (it->second >= count &&
+        (best == pool.freeBlocks.end() || it->second < best->second)) {
+      best = it;
+    }
+  }
+  pool.used += count;
+  if (best != pool.freeBlocks.end()) {
+    const size_t offset = best->first;
+    const size_t size = best->second;
+    pool.freeBlocks.erase(best);
+    if (size > count) pool.freeBlocks[offset + count] = size - count;
+    return offset;
+  }
+
+  if (pool.top + count > pool.capacity) {
+    size_t capacity = std::max(pool.capacity, pool.minCapacity);
+    while (capacity < pool.top + count) capacity *= 2;
+    grow(pool, capacity);
+  }
+  const size_t offset = pool.top;
+  pool.top += count;
+  return offset;
+}
+
+void GeometryArena::releaseIn(Pool& pool, size_t offset, size_t count) {
+  pool.used -= count;
+
+  // Слить с соседними свободными блоками
+  size_t start = offset;
+  size_t end = offset + count;
+  auto next = pool.freeBlocks.lower_bound(start);
+  if (next != pool.freeBlocks.end() && next->first == end) {
+    end += next->second;
+    next = pool.freeBlocks.erase(next);
+  }
+  if (next != pool.freeBlocks.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == start) {
+      start = previous->first;
+      pool.freeBlocks.erase(previous);
+    }
+  }
+
+  // Блок у границы не дыра, а часть пустого хвоста
+  if (end == pool.top) {
+    pool.top = start;
+  } else {
+    pool.freeBlocks[start] = end - start;
+  }
+}
+
+void GeometryArena::grow(Pool& pool, size_t capacity) {
+  GLuint buffer = 0;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, capacity * pool.unit, nullptr,
+               GL_STATIC_DRAW);
+  if (pool.buffer != 0) {
+    // Содержимое переносится на GPU, без чтения в память процессора
+    glBindBuffer(GL_COPY_READ_BUFFER, pool.buffer);
+    if (pool.top > 0) {
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                          pool.top * pool.unit);
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glDeleteBuffers(1, &pool.buffer);
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  pool.buffer = buffer;
+  pool.capacity = capacity;
+  markDirty(pool);
+}
+
+void GeometryArena::compact(Pool& pool, bool vertices) {
+  // Живые диапазоны этого пула по возрастанию смещения
+  std::vector<Handle> order;
+  for (Handle handle = 0; handle < ranges.size(); handle++) {
+    if (!live[handle]) continue;
+    const unsigned int layout = ranges[handle].layout;
+    const Pool& owner =
+        vertices ? vertexPools[layout / 2] : indexPools[layout % 2];
+    if (&owner == &pool) order.push_back(handle);
+  }
+  auto offsetOf = [&](Handle handle) -> size_t& {
+    Range& range = ranges[handle];
+    return vertices ? range.vertexOffset : range.indexOffset;
+  };
+  std::sort(order.begin(), order.end(), [&](Handle a, Handle b) {
+    return offsetOf(a) < offsetOf(b);
+  });
+
+  // Перекрывающиеся участки одного буфера копировать нельзя, поэтому
+  // диапазоны переписываются подряд в новый буфер той же ёмкости
+  GLuint buffer = 0;
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+  glBufferData(GL_COPY_WRITE_BUFFER, pool.capacity * pool.unit, nullptr,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_COPY_READ_BUFFER, pool.buffer);
+  size_t top = 0;
+  for (Handle handle : order) {
+    size_t& offset = offsetOf(handle);
+    const Range& range = ranges[handle];
+    const size_t count = vertices ? range.vertexCount : range.indexCount;
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                        offset * pool.unit, top * pool.unit,
+                        count * pool.unit);
+    offset = top;
+    top += count;
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  glDeleteBuffers(1, &pool.buffer);
+
+  pool.buffer = buffer;
+  pool.top = top;
+  pool.freeBlocks.clear();
+  pool.compactions++;
+  markDirty(pool);
+}
+
+void GeometryArena::markDirty(const Pool& pool) {
+  for (unsigned int layout = 0; layout < 4; layout++) {
+    if (&vertexPools[layout / 2] == &pool ||
+        &indexPools[layout % 2] == &pool) {
+      arrays[layout].dirty = true;
+    }
+  }
+}
+
+GeometryArena::PoolStats GeometryArena::getStats(const Pool& pool) const {
+  PoolStats stats;
+  stats.capacity = pool.capacity * pool.unit;
+  stats.used = pool.used * pool.unit;
+  stats.top = pool.top * pool.unit;
+  stats.freeBlocks = pool.freeBlocks.size();
+  size_t largest = pool.capacity - pool.top;
+  for (const auto& [offset, size] : pool.freeBlocks) {
+    largest = std::max(largest, size);
+  }
+  stats.largestFree = largest * pool.unit;
+  stats.compactions = pool.compactions;
+  return stats;
+}
+
+GeometryArena::PoolStats GeometryArena::getVertexStats(bool packed) const {
+  return getStats(vertexPools[packed ? 0 : 1]);
+}
+
+GeometryArena::PoolStats GeometryArena::getIndexStats(
+    bool shortIndices) const {
+  return getStats(indexPools[shortIndices ? 0 : 1]);
+}
+
+void GeometryArena::printStats() const {
+  size_t meshes = 0;
+  for (bool alive : live) meshes += alive ? 1 : 0;
+  std::cout << "Арена геометрии: мешей " << meshes << std::endl;
+
+  const char* names[] = {"вершины сжатые", "вершины полные",
+                         "индексы 16 бит", "индексы 32 бит"};
+  const PoolStats stats[] = {getVertexStats(true), getVertexStats(false),
+                             getIndexStats(true), getIndexStats(false)};
+  for (size_t i = 0; i < 4; i++) {
+    if (stats[i].capacity == 0) continue;
+    std::cout << "  " << names[i] << ": " << stats[i].used / 1024 << " из "
+              << stats[i].capacity / 1024 << " КБ, дыр " << stats[i].freeBlocks
+              << ", фрагментация " << stats[i].fragmentation()
+              << ", уплотнений " << stats[i].compactions << std::endl;
+  }
+}
+
+void GeometryArena::shutdown() {
+  for (VertexArray& array : arrays) {
+    if (array.vao != 0) glDeleteVertexArrays(1, &array.vao);
+    array = VertexArray();
+  }
+  for (Pool* pool : {&vertexPools[0], &vertexPools[1], &indexPools[0],
+                     &indexPools[1]}) {
+    if (pool->buffer != 0) glDeleteBuffers(1, &pool->buffer);
+    pool->buffer = 0;
+    pool->capacity = pool->top = pool->used = 0;
+    pool->freeBlocks.clear();
+  }
+  ranges.clear();
+  live.clear();
+  freeHandles.clear();
+}
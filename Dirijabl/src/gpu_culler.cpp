@@ -0,0 +1,282 @@
+#include "gpu_culler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "program_cache.h"
+#include "vertex.h"
+
+namespace {
+
+const char* cullVertexSource = R"(
+#version 330 core
+
+layout(location = 0) in mat4 instanceMatrix;
+layout(location = 4) in vec4 instanceNormalScale;
+
+uniform vec4 planes[6];
+uniform vec4 sphere; // Mesh bounding sphere: center, radius
+
+// LOD selection: simplification error projected to pixels
+uniform vec3 cameraPosition;
+uniform float pixelsPerUnit; // Pre-divided by the allowed pixel error
+uniform float lodErrors[4];
+uniform int lodCount;
+uniform int lod; // Level written by this pass
+
+out mat4 vMatrix;
+out vec4 vNormalScale;
+flat out int vVisible;
+
+void main() {
+    vec3 center = (instanceMatrix * vec4(sphere.xyz, 1.0)).xyz;
+    // Largest axis scale from 1 / scale^2
+    float scale = inversesqrt(min(instanceNormalScale.x,
+        min(instanceNormalScale.y, instanceNormalScale.z)));
+    float radius = sphere.w * scale;
+
+    vVisible = 1;
+    for (int i = 0; i < 6; i++) {
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius) vVisible = 0;
+    }
+
+    // Errors grow with the level, so the last acceptable one is the coarsest
+    int selected = 0;
+    if (pixelsPerUnit > 0.0) {
+        float distance = length(center - cameraPosition);
+        for (int i = 1; i < lodCount; i++) {
+            if (lodErrors[i] * scale * pixelsPerUnit <= distance) selected = i;
+        }
+    }
+    if (selected != lod) vVisible = 0;
+
+    vMatrix = instanceMatrix;
+    vNormalScale = instanceNormalScale;
+}
+)";
+
+const char* cullGeometrySource = R"(
+#version 330 core
+
+layout(points) in;
+layout(points, max_vertices = 1) out;
+
+in mat4 vMatrix[];
+in vec4 vNormalScale[];
+flat in int vVisible[];
+
+out mat4 outMatrix;
+out vec4 outNormalScale;
+
+void main() {
+    if (vVisible[0] == 0) return;
+    outMatrix = vMatrix[0];
+    outNormalScale = vNormalScale[0];
+    EmitVertex();
+    EndPrimitive();
+}
+)";
+
+}  // namespace
+
+// GpuCullBuffers
+
+GpuCullBuffers::~GpuCullBuffers() { release(); }
+
+void GpuCullBuffers::release() {
+  if (inputVAO != 0) glDeleteVertexArrays(1, &inputVAO);
+  for (OutputSet& set : sets) {
+    if (set.buffers[0] != 0) glDeleteBuffers(kMaxLodLevels, set.buffers);
+    if (set.queries[0] != 0) glDeleteQueries(kMaxLodLevels, set.queries);
+    set = OutputSet();
+  }
+  inputVAO = 0;
+  source = 0;
+  capacity = 0;
+  resolved = -1;
+  frame = 0;
+}
+
+bool GpuCullBuffers::prepare(GLuint instanceBuffer, size_t newCapacity) {
+  if (instanceBuffer == source && newCapacity <= capacity) return false;
+
+  release();
+  source = instanceBuffer;
+  capacity = newCapacity;
+
+  // Вход: данные экземпляров как вершинные атрибуты, по точке на экземпляр
+  glGenVertexArrays(1, &inputVAO);
+  glBindVertexArray(inputVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+  for (int i = 0; i < 5; i++) {
+    glEnableVertexAttribArray(i);
+    glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+                          (void*)(i * sizeof(glm::vec4)));
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+
+  // Любой уровень может получить все экземпляры
+  for (OutputSet& set : sets) {
+    glGenBuffers(kMaxLodLevels, set.buffers);
+    for (GLuint output : set.buffers) {
+      glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, output);
+      glBufferData(GL_TRANSFORM_FEEDBACK_BUFFER,
+                   capacity * sizeof(InstanceTransform), nullptr,
+                   GL_DYNAMIC_COPY);
+    }
+    glGenQueries(kMaxLodLevels, set.queries);
+  }
+  glBindBuffer(GL_TRANSFORM_FEEDBACK_BUFFER, 0);
+  return true;
+}
+
+// GpuCuller
+
+GpuCuller::GpuCuller() {
+  // Выход подряд в порядке полей InstanceTransform. Имена выходов тоже
+  // часть программы, поэтому входят в ключ кэша.
+  const std::vector<const char*> varyings = {"outMatrix", "outNormalScale"};
+  program = ProgramCache::instance().build(
+      "отсечения",
+      {{GL_VERTEX_SHADER, {cullVertexSource}},
+       {GL_GEOMETRY_SHADER, {cullGeometrySource}}},
+      varyings, [&varyings](GLuint linked) {
+        glTransformFeedbackVaryings(
+            linked, static_cast<GLsizei>(varyings.size()), varyings.data(),
+            GL_INTERLEAVED_ATTRIBS);
+      });
+  if (program == 0) return;
+
+  planesLocation = glGetUniformLocation(program, "planes");
+  sphereLocation = glGetUniformLocation(program, "sphere");
+  cameraLocation = glGetUniformLocation(program, "cameraPosition");
+  pixelsPerUnitLocation = glGetUniformLocation(program, "pixelsPerUnit");
+  lodErrorsLocation = glGetUniformLocation(program, "lodErrors");
+  lodCountLocation = glGetUniformLocation(program, "lodCount");
+  lodLocation = glGetUniformLocation(program, "lod");
+}
+
+GpuCuller::~GpuCuller() {
+  if (program != 0) glDeleteProgram(program);
+}
+
+void GpuCuller::readResult(GpuCullBuffers::OutputSet& set) {
+  for (int lod = 0; lod < set.lodCount; lod++) {
+    GLuint visible = 0;
+    glGetQueryObjectuiv(set.queries[lod], GL_QUERY_RESULT, &visible);
+    set.visible[lod] = visible;
+  }
+  set.pending = false;
+}
+
+GpuCuller::Result GpuCuller::cull(GpuCullBuffers& buffers,
+                                  const Frustum& frustum,
+                                  const LodView& lodView, const Bounds& bounds,
+                                  const std::vector<MeshLod>& lods,
+                                  size_t count) {
+  if (program == 0 || buffers.inputVAO == 0 || count > buffers.capacity) {
+    return {};
+  }
+
+  const int lodCount =
+      static_cast<int>(std::clamp<size_t>(lods.size(), 1, kMaxLodLevels));
+  float lodErrors[kMaxLodLevels] = {};
+  for (size_t i = 0; i < lods.size() && i < kMaxLodLevels; i++) {
+    lodErrors[i] = lods[i].error;
+  }
+
+  // Забрать готовые результаты, от старых к новым: рисоваться будет самый
+  // свежий из них, а прежний набор освобождается. Проходы уровней идут
+  // подряд, поэтому запрос последнего готов последним.
+  using OutputSet = GpuCullBuffers::OutputSet;
+  for (;;) {
+    int oldest = -1;
+    for (int i = 0; i < GpuCullBuffers::kOutputSets; i++) {
+      const OutputSet& set = buffers.sets[i];
+      if (set.pending &&
+          (oldest < 0 || set.frame < buffers.sets[oldest].frame)) {
+        oldest = i;
+      }
+    }
+    if (oldest < 0) break;
+
+    OutputSet& set = buffers.sets[oldest];
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(set.queries[set.lodCount - 1],
+                        GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) break;
+    readResult(set);
+    buffers.resolved = oldest;
+  }
+
+  // Писать в свободный набор; если GPU отстал и свободных нет, в самый
+  // новый из ждущих, чтобы старший успел дойти до готовности
+  int target = -1;
+  for (int i = 0; i < GpuCullBuffers::kOutputSets; i++) {
+    if (i == buffers.resolved) continue;
+    const OutputSet& set = buffers.sets[i];
+    if (!set.pending) {
+      target = i;
+      break;
+    }
+    if (target < 0 || set.frame > buffers.sets[target].frame) target = i;
+  }
+  OutputSet& output = buffers.sets[target];
+
+  GLint previousProgram = 0;
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  glUseProgram(program);
+  glUniform4fv(planesLocation, 6, &frustum.getPlanes()[0][0]);
+  glUniform4f(sphereLocation, bounds.center.x, bounds.center.y,
+              bounds.center.z, bounds.radius);
+  glUniform3f(cameraLocation, lodView.position.x, lodView.position.y,
+              lodView.position.z);
+  glUniform1f(pixelsPerUnitLocation,
+              lodView.maxPixelError > 0.0f
+                  ? lodView.pixelsPerUnit / lodView.maxPixelError
+                  : 0.0f);
+  glUniform1fv(lodErrorsLocation, kMaxLodLevels, lodErrors);
+  glUniform1i(lodCountLocation, lodCount);
+
+  glEnable(GL_RASTERIZER_DISCARD);
+  glBindVertexArray(buffers.inputVAO);
+
+  // По проходу на уровень: каждый пишет свой буфер
+  for (int lod = 0; lod < lodCount; lod++) {
+    glUniform1i(lodLocation, lod);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, output.buffers[lod]);
+
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN,
+                 output.queries[lod]);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(count));
+    glEndTransformFeedback();
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+  }
+
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  glBindVertexArray(0);
+  glDisable(GL_RASTERIZER_DISCARD);
+  glUseProgram(previousProgram);
+
+  output.pending = true;
+  output.lodCount = lodCount;
+  output.frame = ++buffers.frame;
+
+  // Готового набора ещё нет или в нём другое число уровней: подождать
+  // только что записанный
+  if (buffers.resolved < 0 ||
+      buffers.sets[buffers.resolved].lodCount != lodCount) {
+    readResult(output);
+    buffers.resolved = target;
+  }
+
+  const OutputSet& ready = buffers.sets[buffers.resolved];
+  Result result;
+  for (int lod = 0; lod < lodCount; lod++) {
+    result.buffers[lod] = ready.buffers[lod];
+    result.visible[lod] = ready.visible[lod];
+  }
+  return result;
+}
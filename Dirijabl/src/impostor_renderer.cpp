@@ -0,0 +1,428 @@
+#include "impostor_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iostream>
+
+#include "mesh.h"
+#include "program_cache.h"
+#include "vertex.h"
+
+namespace {
+
+// Both bake stages are compiled after "#version" and, for the texture
+// array variant, "#define TEXTURE_ARRAY"
+const char* bakeVertexSource = R"(
+layout(location = 0) in vec3 packedPosition; // Raw or bounding box fraction
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) in vec3 normal;
+
+uniform mat4 viewProjection;
+uniform vec3 positionOffset = vec3(0.0); // Mesh position decode
+uniform vec3 positionScale = vec3(1.0);
+
+out vec2 TexCoord;
+out vec3 Normal;
+
+void main() {
+    vec3 position = positionOffset + packedPosition * positionScale;
+    gl_Position = viewProjection * vec4(position, 1.0);
+    TexCoord = texCoord;
+    Normal = normal;
+}
+)";
+
+const char* bakeFragmentSource = R"(
+in vec2 TexCoord;
+in vec3 Normal;
+
+layout(location = 0) out vec4 ColorOut;
+layout(location = 1) out vec4 NormalOut;
+
+#ifdef TEXTURE_ARRAY
+uniform sampler2DArray textureSampler;
+uniform float layer;
+#else
+uniform sampler2D textureSampler;
+#endif
+
+void main() {
+#ifdef TEXTURE_ARRAY
+    vec4 texColor = texture(textureSampler, vec3(TexCoord, layer));
+#else
+    vec4 texColor = texture(textureSampler, TexCoord);
+#endif
+    if (texColor.a < 0.1) discard;
+    ColorOut = texColor;
+    // Mesh-space normal packed into [0, 1]
+    NormalOut = vec4(normalize(Normal) * 0.5 + 0.5, 1.0);
+}
+)";
+
+const char* drawVertexSource = R"(
+#version 330 core
+
+layout(location = 0) in mat4 instanceMatrix;
+layout(location = 4) in vec4 instanceNormalScale; // w: impostor share
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 cameraPosition;
+uniform vec4 sphere; // Baked sphere in mesh space: center, radius
+uniform int views;
+
+out vec2 TexCoord;
+flat out mat3 NormalMatrix;
+flat out float Fade;
+
+void main() {
+    // Triangle strip corners from the vertex index: (-1,-1) .. (1,1)
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+
+    // Camera direction in the instance's own frame. For a rotation and
+    // scale M^-1 = S^-2 * M^T, and S^-2 is the normal scale.
+    vec3 center = (instanceMatrix * vec4(sphere.xyz, 1.0)).xyz;
+    vec3 toCamera = instanceNormalScale.xyz *
+        (transpose(mat3(instanceMatrix)) * (cameraPosition - center));
+    float azimuth = atan(toCamera.x, toCamera.z);
+
+    // Nearest baked view; view i looks from azimuth i * step
+    float step = 6.28318531 / float(views);
+    float tile = mod(floor(azimuth / step + 0.5), float(views));
+
+    // Quad through the sphere center, turned to the camera around Y
+    vec3 right = vec3(cos(azimuth), 0.0, -sin(azimuth));
+    vec3 local = sphere.xyz +
+        (right * corner.x + vec3(0.0, corner.y, 0.0)) * sphere.w;
+    gl_Position = projection * view * instanceMatrix * vec4(local, 1.0);
+
+    TexCoord = vec2((tile + corner.x * 0.5 + 0.5) / float(views),
+                    corner.y * 0.5 + 0.5);
+    NormalMatrix = mat3(instanceMatrix) * mat3(
+        instanceNormalScale.x, 0.0, 0.0,
+        0.0, instanceNormalScale.y, 0.0,
+        0.0, 0.0, instanceNormalScale.z);
+    Fade = instanceNormalScale.w;
+}
+)";
+
+const char* drawFragmentSource = R"(
+#version 330 core
+
+in vec2 TexCoord;
+flat in mat3 NormalMatrix;
+flat in float Fade;
+
+out vec4 FragColor;
+
+uniform sampler2D colorAtlas;
+uniform sampler2D normalAtlas;
+uniform vec3 lightDirection;
+uniform vec3 lightAmbient;
+uniform vec3 lightDiffuse;
+uniform float opacity;
+
+// Ordered 4x4 Bayer threshold in (0, 1)
+float ditherThreshold() {
+    const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0,
+                                      12.0, 4.0, 14.0, 6.0,
+                                      3.0, 11.0, 1.0, 9.0,
+                                      15.0, 7.0, 13.0, 5.0);
+    ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+    return (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+}
+
+void main() {
+    // Cross-fade: the mesh keeps the pixels where the threshold is
+    // below its fade, the impostor keeps the rest
+    if (ditherThreshold() >= Fade) discard;
+
+    vec4 texColor = texture(colorAtlas, TexCoord);
+    float finalAlpha = texColor.a * opacity;
+    if (finalAlpha < 0.1) discard;
+
+    vec3 normal = texture(normalAtlas, TexCoord).xyz * 2.0 - 1.0;
+    vec3 norm = normalize(NormalMatrix * normal);
+    vec3 lightDir = normalize(-lightDirection);
+
+    // Ambient and diffuse as in the main shader; specular is lost at range
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 result = (lightAmbient + lightDiffuse * diff) * texColor.rgb;
+    FragColor = vec4(result, finalAlpha);
+}
+)";
+
+}  // namespace
+
+// ImpostorAtlas
+
+ImpostorAtlas::~ImpostorAtlas() { release(); }
+
+void ImpostorAtlas::release() {
+  if (textures[0] != 0) glDeleteTextures(2, textures);
+  if (drawVAO != 0) glDeleteVertexArrays(1, &drawVAO);
+  textures[0] = textures[1] = 0;
+  drawVAO = 0;
+}
+
+// ImpostorRenderer
+
+ImpostorRenderer::ImpostorRenderer() {
+  ProgramCache& cache = ProgramCache::instance();
+  const char* bakeDefines[2] = {"#version 330 core\n",
+                                "#version 330 core\n#define TEXTURE_ARRAY\n"};
+  const char* bakeNames[2] = {"запекания импосторов",
+                              "запекания импосторов из массива текстур"};
+  for (int i = 0; i < 2; i++) {
+    BakeProgram& bake = bakePrograms[i];
+    bake.id = cache.build(
+        bakeNames[i],
+        {{GL_VERTEX_SHADER, {bakeDefines[i], bakeVertexSource}},
+         {GL_FRAGMENT_SHADER, {bakeDefines[i], bakeFragmentSource}}});
+    if (bake.id == 0) continue;
+
+    bake.viewProjectionLocation =
+        glGetUniformLocation(bake.id, "viewProjection");
+    bake.positionOffsetLocation =
+        glGetUniformLocation(bake.id, "positionOffset");
+    bake.positionScaleLocation = glGetUniformLocation(bake.id, "positionScale");
+    bake.layerLocation = glGetUniformLocation(bake.id, "layer");
+    glUseProgram(bake.id);
+    glUniform1i(glGetUniformLocation(bake.id, "textureSampler"), 0);
+  }
+  drawProgram = cache.build("рисования импосторов",
+                            {{GL_VERTEX_SHADER, {drawVertexSource}},
+                             {GL_FRAGMENT_SHADER, {drawFragmentSource}}});
+  if (!isValid()) {
+    glUseProgram(0);
+    return;
+  }
+
+  viewLocation = glGetUniformLocation(drawProgram, "view");
+  projectionLocation = glGetUniformLocation(drawProgram, "projection");
+  cameraLocation = glGetUniformLocation(drawProgram, "cameraPosition");
+  sphereLocation = glGetUniformLocation(drawProgram, "sphere");
+  viewsLocation = glGetUniformLocation(drawProgram, "views");
+  opacityLocation = glGetUniformLocation(drawProgram, "opacity");
+  lightDirectionLocation = glGetUniformLocation(drawProgram, "lightDirection");
+  lightAmbientLocation = glGetUniformLocation(drawProgram, "lightAmbient");
+  lightDiffuseLocation = glGetUniformLocation(drawProgram, "lightDiffuse");
+
+  // Атласы всегда на блоках 0 и 1
+  glUseProgram(drawProgram);
+  glUniform1i(glGetUniformLocation(drawProgram, "colorAtlas"), 0);
+  glUniform1i(glGetUniformLocation(drawProgram, "normalAtlas"), 1);
+  glUseProgram(0);
+}
+
+ImpostorRenderer::~ImpostorRenderer() {
+  for (const BakeProgram& bake : bakePrograms) {
+    if (bake.id != 0) glDeleteProgram(bake.id);
+  }
+  if (drawProgram != 0) glDeleteProgram(drawProgram);
+}
+
+void ImpostorRenderer::setLight(const glm::vec3& direction,
+                                const glm::vec3& ambient,
+                                const glm::vec3& diffuse) {
+  lightDirection = direction;
+  lightAmbient = ambient;
+  lightDiffuse = diffuse;
+}
+
+bool ImpostorRenderer::bake(ImpostorAtlas& atlas, const Mesh& mesh,
+                            GLenum target, GLuint texture, int layer) const {
+  if (!isValid() || !mesh.isUploaded() || mesh.indexCount == 0) return false;
+  const BakeProgram& bakeProgram =
+      bakePrograms[target == GL_TEXTURE_2D_ARRAY ? 1 : 0];
+
+  atlas.release();
+  const ImpostorSettings& settings = atlas.settings;
+  const GLsizei tile = static_cast<GLsizei>(settings.tileSize);
+  const GLsizei width = tile * static_cast<GLsizei>(settings.views);
+
+  // Сохранить состояние, которое меняет запекание
+  GLint previousFramebuffer = 0, previousProgram = 0, previousTexture = 0;
+  GLint previousActiveTexture = 0, previousArray = 0;
+  GLint previousViewport[4];
+  GLfloat previousClearColor[4];
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &previousActiveTexture);
+  glActiveTexture(GL_TEXTURE0);
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+  glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousArray);
+  glGetIntegerv(GL_VIEWPORT, previousViewport);
+  glGetFloatv(GL_COLOR_CLEAR_VALUE, previousClearColor);
+  const GLboolean blend = glIsEnabled(GL_BLEND);
+
+  glGenTextures(2, atlas.textures);
+  for (GLuint target : atlas.textures) {
+    glBindTexture(GL_TEXTURE_2D, target);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, tile, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  }
+
+  GLuint depth = 0;
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, tile);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  GLuint framebuffer = 0;
+  glGenFramebuffers(1, &framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         atlas.textures[0], 0);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                         atlas.textures[1], 0);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depth);
+  const GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(2, drawBuffers);
+
+  const bool complete =
+      glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+  if (complete) {
+    glDisable(GL_BLEND);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Свой VAO с буферами арены, без экземпляров; меш рисуется со своего
+    // первого индекса и первой вершины
+    GLuint vao = 0;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    mesh.setupAttributes();
+
+    glUseProgram(bakeProgram.id);
+    glBindTexture(target, texture);
+    if (bakeProgram.layerLocation >= 0) {
+      glUniform1f(bakeProgram.layerLocation, static_cast<float>(layer));
+    }
+    const PositionDecode& decode = mesh.getPositionDecode();
+    glUniform3fv(bakeProgram.positionOffsetLocation, 1, &decode.offset[0]);
+    glUniform3fv(bakeProgram.positionScaleLocation, 1, &decode.scale[0]);
+
+    // Ортографическая камера с азимута i * step смотрит на центр сферы;
+    // сфера ровно вписана в клетку
+    const Bounds& bounds = mesh.getBounds();
+    const float radius = std::max(bounds.radius, 1e-4f);
+    const float step = 6.28318531f / static_cast<float>(settings.views);
+    glm::mat4 projection =
+        glm::ortho(-radius, radius, -radius, radius, radius, 3.0f * radius);
+    for (unsigned int i = 0; i < settings.views; i++) {
+      const float azimuth = step * static_cast<float>(i);
+      glm::vec3 direction(std::sin(azimuth), 0.0f, std::cos(azimuth));
+      glm::mat4 view =
+          glm::lookAt(bounds.center + direction * (2.0f * radius),
+                      bounds.center, glm::vec3(0.0f, 1.0f, 0.0f));
+      glm::mat4 viewProjection = projection * view;
+
+      glViewport(static_cast<GLint>(i) * tile, 0, tile, tile);
+      glUniformMatrix4fv(bakeProgram.viewProjectionLocation, 1, GL_FALSE,
+                         &viewProjection[0][0]);
+      glDrawElementsBaseVertex(
+          GL_TRIANGLES, static_cast<GLsizei>(mesh.indexCount),
+          mesh.getIndexType(),
+          (void*)(mesh.getFirstIndex() * mesh.getIndexSize()),
+          mesh.getBaseVertex());
+    }
+
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vao);
+
+    atlas.bounds = bounds;
+    atlas.bounds.radius = radius;
+  } else {
+    std::cerr << "Кадровый буфер для атласа импосторов не готов" << std::endl;
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteRenderbuffers(1, &depth);
+
+  if (complete) {
+    for (GLuint target : atlas.textures) {
+      glBindTexture(GL_TEXTURE_2D, target);
+      glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glGenVertexArrays(1, &atlas.drawVAO);
+  } else {
+    atlas.release();
+  }
+
+  glBindTexture(GL_TEXTURE_2D, previousTexture);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, previousArray);
+  glActiveTexture(previousActiveTexture);
+  glUseProgram(previousProgram);
+  glViewport(previousViewport[0], previousViewport[1], previousViewport[2],
+             previousViewport[3]);
+  glClearColor(previousClearColor[0], previousClearColor[1],
+               previousClearColor[2], previousClearColor[3]);
+  if (blend) glEnable(GL_BLEND);
+  return complete;
+}
+
+void ImpostorRenderer::draw(const ImpostorAtlas& atlas, GLuint buffer,
+                            size_t offset, size_t count,
+                            const LodView& view) const {
+  if (!isValid() || !atlas.isBaked() || count == 0) return;
+
+  GLint previousProgram = 0, previousActiveTexture = 0;
+  GLint previousTextures[2] = {0, 0};
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &previousActiveTexture);
+
+  glUseProgram(drawProgram);
+  glUniformMatrix4fv(viewLocation, 1, GL_FALSE, &view.view[0][0]);
+  glUniformMatrix4fv(projectionLocation, 1, GL_FALSE,
+                     &view.projection[0][0]);
+  glUniform3f(cameraLocation, view.position.x, view.position.y,
+              view.position.z);
+  const Bounds& bounds = atlas.bounds;
+  glUniform4f(sphereLocation, bounds.center.x, bounds.center.y,
+              bounds.center.z, bounds.radius);
+  glUniform1i(viewsLocation, static_cast<GLint>(atlas.settings.views));
+  glUniform1f(opacityLocation, atlas.settings.opacity);
+  glUniform3f(lightDirectionLocation, lightDirection.x, lightDirection.y,
+              lightDirection.z);
+  glUniform3f(lightAmbientLocation, lightAmbient.x, lightAmbient.y,
+              lightAmbient.z);
+  glUniform3f(lightDiffuseLocation, lightDiffuse.x, lightDiffuse.y,
+              lightDiffuse.z);
+
+  for (int unit = 0; unit < 2; unit++) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTextures[unit]);
+    glBindTexture(GL_TEXTURE_2D, atlas.textures[unit]);
+  }
+
+  // Вершин нет: углы берутся из gl_VertexID, а экземпляры читаются из
+  // того же кольцевого буфера, что и для меша
+  glBindVertexArray(atlas.drawVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  for (int i = 0; i < 5; i++) {
+    glEnableVertexAttribArray(i);
+    glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+                          (void*)(offset + i * sizeof(glm::vec4)));
+    glVertexAttribDivisor(i, 1);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+  glBindVertexArray(0);
+
+  for (int unit = 1; unit >= 0; unit--) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, previousTextures[unit]);
+  }
+  glActiveTexture(previousActiveTexture);
+  glUseProgram(previousProgram);
+}
@@ -0,0 +1,129 @@
+#include "instance_stream.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// Начальная ёмкость области в элементах
+constexpr size_t kMinCapacity = 64;
+
+// Время одного ожидания fence, нс
+constexpr GLuint64 kWaitTimeout = 1000000;
+
+}  // namespace
+
+InstanceStream::InstanceStream(size_t stride) : stride(stride) {}
+
+InstanceStream::~InstanceStream() { release(); }
+
+void InstanceStream::allocate(size_t count) {
+  release();
+
+  capacity = std::max(kMinCapacity, count);
+  const size_t bytes = capacity * stride * kRegions;
+
+  glGenBuffers(1, &buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+  if (GLEW_ARB_buffer_storage) {
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_ARRAY_BUFFER, bytes, nullptr, flags);
+    persistent = glMapBufferRange(GL_ARRAY_BUFFER, 0, bytes, flags);
+    if (!persistent) {
+      std::cerr << "Не удалось постоянно отобразить буфер экземпляров"
+                << std::endl;
+    }
+  }
+
+  if (!persistent) {
+    glBufferData(GL_ARRAY_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void InstanceStream::release() {
+  for (auto& f : fences) {
+    if (f) {
+      glDeleteSync(f);
+      f = nullptr;
+    }
+  }
+
+  if (buffer != 0) {
+    if (persistent || mapped) {
+      glBindBuffer(GL_ARRAY_BUFFER, buffer);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    // Драйвер освободит память, когда GPU закончит старые команды
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+  }
+
+  persistent = nullptr;
+  mapped = false;
+  capacity = 0;
+}
+
+void InstanceStream::waitRegion(int index) {
+  GLsync f = fences[index];
+  if (!f) return;
+
+  GLenum result = glClientWaitSync(f, 0, 0);
+  if (result == GL_TIMEOUT_EXPIRED) {
+    stallCount++;
+    do {
+      result = glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, kWaitTimeout);
+    } while (result == GL_TIMEOUT_EXPIRED);
+  }
+  if (result == GL_WAIT_FAILED) {
+    std::cerr << "Ошибка ожидания буфера экземпляров" << std::endl;
+  }
+
+  glDeleteSync(f);
+  fences[index] = nullptr;
+}
+
+void* InstanceStream::map(size_t count) {
+  if (mapped) unmap();
+
+  if (count > capacity) {
+    allocate(std::max(count, capacity * 2));
+  }
+
+  region = (region + 1) % kRegions;
+  waitRegion(region);
+
+  const size_t offset = region * capacity * stride;
+  if (persistent) {
+    return static_cast<char*>(persistent) + offset;
+  }
+
+  // Область свободна по fence, поэтому драйверу не нужно синхронизироваться
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  void* ptr = glMapBufferRange(
+      GL_ARRAY_BUFFER, offset, std::max<size_t>(count, 1) * stride,
+      GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+          GL_MAP_INVALIDATE_RANGE_BIT);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  mapped = ptr != nullptr;
+  return ptr;
+}
+
+size_t InstanceStream::unmap() {
+  if (mapped) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    mapped = false;
+  }
+  return region * capacity * stride;
+}
+
+void InstanceStream::fence() {
+  if (fences[region]) glDeleteSync(fences[region]);
+  fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
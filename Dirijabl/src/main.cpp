@@ -12,9 +12,13 @@
 #include <sstream>
 #include <vector>
 
+#include "async_loader.h"
 #include "camera.h"
+#include "geometry_arena.h"
 #include "model.h"
+#include "render_queue.h"
 #include "shader.h"
+#include "texture_array.h"
 
 // Models
 Model* airshipModel = nullptr;
@@ -26,14 +30,19 @@ Model* presentModel = nullptr;
 Model* groundModel = nullptr;
 
 // Instances
-ModelInstance* airshipInstance = nullptr;
-std::vector<ModelInstance*> houseInstances;
-std::vector<ModelInstance*> treeInstances;
-std::vector<ModelInstance*> cloudInstances;
-std::vector<ModelInstance*> balloonInstances;
-std::vector<ModelInstance*> presentInstances;
+ModelInstance airshipInstance;
+std::vector<ModelInstance> houseInstances;
+std::vector<ModelInstance> treeInstances;
+std::vector<ModelInstance> cloudInstances;
+std::vector<ModelInstance> balloonInstances;
+std::vector<ModelInstance> presentInstances;
 
 Shader* shader = nullptr;
+FrameUniformBuffer* frameUniforms = nullptr;
+RenderQueue* renderQueue = nullptr;
+TextureArray* textureArray = nullptr;
+GpuCuller* gpuCuller = nullptr;
+ImpostorRenderer* impostorRenderer = nullptr;
 Camera* camera = nullptr;
 
 // Directional light parameters (sun)
@@ -70,9 +79,10 @@ std::uniform_real_distribution<float> distBalloonHeight(10.0f, 25.0f);
 
 // Present dropping
 struct Present {
-  ModelInstance* instance;
+  ModelInstance instance;
   glm::vec3 velocity;
   bool active;
+  bool landed = false;
   float spawnTime;
 };
 
@@ -85,30 +95,42 @@ float presentDespawnTime = 5.0f;     // Seconds after hitting ground
 float windStrength = 0.5f;
 float windFrequency = 0.5f;
 
-GLuint loadTexture(const std::string& filename) {
-  sf::Image image;
-  if (image.loadFromFile(filename)) {
-    image.flipVertically();
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-    sf::Vector2u size = image.getSize();
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, image.getPixelsPtr());
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    std::cout << "Texture loaded: " << filename << std::endl;
-    return texture;
-  } else {
-    std::cerr << "Couldn't load texture: " << filename << std::endl;
-    return 0;
+// Models sample one texture array instead of binding their own textures
+// (F2 switches back for comparison)
+bool materialBatching = true;
+
+// Performance counters, printed once per second while enabled (F1)
+bool showStats = false;
+float statsTimer = 0.0f;
+int statsFrames = 0;
+size_t statsUploadBytes = 0;
+size_t statsUploadRanges = 0;
+size_t statsVisible = 0;
+size_t statsCulled = 0;
+size_t statsTriangles = 0;
+size_t statsImpostors = 0;
+size_t statsDrawCalls = 0;
+size_t statsProgramChanges = 0;
+size_t statsTextureChanges = 0;
+// Shader uniform counters at the last report
+size_t statsUniformUploadsMark = 0;
+size_t statsUniformSkipsMark = 0;
+
+// GPU time of the scene pass. Two timer queries alternate so the result of
+// the previous frame is read without waiting on the current one.
+GLuint gpuTimerQueries[2] = {0, 0};
+unsigned int gpuTimerFrame = 0;
+double statsGpuMs = 0.0;
+int statsGpuSamples = 0;
+
+void setMaterialBatching(bool enabled) {
+  materialBatching = enabled && textureArray && textureArray->isValid();
+  for (Model* model : {airshipModel, houseModel, treeModel, cloudModel,
+                       balloonModel, presentModel, groundModel}) {
+    if (!model) continue;
+    model->setTextureArray(materialBatching ? textureArray : nullptr);
+    // Build the variant now so the render queue never compiles mid-frame
+    if (shader) shader->prepare(model->getShaderFeatures());
   }
 }
 
@@ -130,9 +152,15 @@ void initResources() {
   unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
   rng.seed(seed);
 
-  // Load models (using available models or creating fallback)
+  // Load models (using available models or creating fallback).
+  // Meshes and textures come from the shared registry, so repeated files
+  // (sphere for clouds and balloons, cube for presents and ground) are
+  // loaded and uploaded once. Files are read on background threads; until
+  // a mesh or texture arrives, the model is drawn as the fallback cube.
+  AssetRegistry::instance().setAsyncLoading(true);
+
   airshipModel = new Model("models/airship.obj");
-  if (airshipModel->vertices.empty()) {
+  if (airshipModel->isFallback()) {
     // If airship model doesn't exist, use chair as placeholder
     delete airshipModel;
     airshipModel = new Model("models/chair.obj");
@@ -140,7 +168,7 @@ void initResources() {
   airshipModel->loadTexture("textures/chair.png");
 
   houseModel = new Model("models/house.obj");
-  if (houseModel->vertices.empty()) {
+  if (houseModel->isFallback()) {
     // Use table as house placeholder
     delete houseModel;
     houseModel = new Model("models/table.obj");
@@ -148,40 +176,46 @@ void initResources() {
   houseModel->loadTexture("textures/table.png");
 
   treeModel = new Model("models/tree.obj");
-  if (treeModel->vertices.empty()) {
+  if (treeModel->isFallback()) {
     // Use vase as tree placeholder
     delete treeModel;
     treeModel = new Model("models/vase.obj");
   }
   treeModel->loadTexture("textures/vase.png");
+  treeModel->setShaderFeatures(kShaderTreeSway | kShaderAlphaTest);
 
   cloudModel = new Model("models/cloud.obj");
-  if (cloudModel->vertices.empty()) {
+  if (cloudModel->isFallback()) {
     // Create simple cloud model (sphere)
     delete cloudModel;
     cloudModel = new Model("models/sphere.obj");
-    if (cloudModel->vertices.empty()) {
+    if (cloudModel->isFallback()) {
       // Final fallback: use cube
       delete cloudModel;
       cloudModel = new Model("models/cube.obj");
     }
   }
   cloudModel->loadTexture("textures/sphere.jpg");
+  cloudModel->setShaderFeatures(kShaderCloudDrift);
 
   balloonModel = new Model("models/balloon.obj");
-  if (balloonModel->vertices.empty()) {
+  if (balloonModel->isFallback()) {
     // Use sphere for balloon
     delete balloonModel;
     balloonModel = new Model("models/sphere.obj");
-    if (balloonModel->vertices.empty()) {
+    if (balloonModel->isFallback()) {
       delete balloonModel;
       balloonModel = new Model("models/cube.obj");
     }
   }
   balloonModel->loadTexture("textures/sphere.jpg");
+  balloonModel->setShaderFeatures(kShaderBalloonBob);
 
   presentModel = new Model("models/cube.obj");
   presentModel->loadTexture("textures/cube.jpg");
+  // Every falling present moves each frame, so its transforms are streamed
+  // through a ring buffer instead of patched slot by slot
+  presentModel->setInstanceStreaming(true);
 
   // Create ground (simple plane)
   groundModel = new Model("models/cube.obj");
@@ -189,72 +223,108 @@ void initResources() {
 
   // Create airship instance
   airshipInstance = airshipModel->createInstance();
-  airshipInstance->setPosition(glm::vec3(0.0f, 20.0f, 0.0f));
-  airshipInstance->setScale(glm::vec3(0.5f, 0.5f, 0.5f));
+  airshipInstance.setPosition(glm::vec3(0.0f, 20.0f, 0.0f));
+  airshipInstance.setScale(glm::vec3(0.5f, 0.5f, 0.5f));
 
   // Create houses (5 instances)
   for (int i = 0; i < 5; i++) {
-    ModelInstance* house = houseModel->createInstance();
+    ModelInstance house = houseModel->createInstance();
     float x = distPos(rng);
     float z = distPos(rng);
-    house->setPosition(glm::vec3(x, 0.0f, z));
-    house->setRotation(glm::vec3(0.0f, 1.0f, 0.0f), distRot(rng));
+    house.setPosition(glm::vec3(x, 0.0f, z));
+    house.setRotation(glm::vec3(0.0f, 1.0f, 0.0f), distRot(rng));
     float scale = distScale(rng) * 0.3f;
-    house->setScale(glm::vec3(scale, scale * 1.5f, scale));
+    house.setScale(glm::vec3(scale, scale * 1.5f, scale));
     houseInstances.push_back(house);
   }
 
   // Create decor objects (trees, 5 instances)
   for (int i = 0; i < 5; i++) {
-    ModelInstance* tree = treeModel->createInstance();
+    ModelInstance tree = treeModel->createInstance();
     float x = distPos(rng);
     float z = distPos(rng);
-    tree->setPosition(glm::vec3(x, 0.0f, z));
-    tree->setRotation(glm::vec3(0.0f, 1.0f, 0.0f), distRot(rng));
+    tree.setPosition(glm::vec3(x, 0.0f, z));
+    tree.setRotation(glm::vec3(0.0f, 1.0f, 0.0f), distRot(rng));
     float scale = distScale(rng) * 0.2f;
-    tree->setScale(glm::vec3(scale, scale * 2.0f, scale));
+    tree.setScale(glm::vec3(scale, scale * 2.0f, scale));
     treeInstances.push_back(tree);
   }
 
   // Create clouds (5 instances)
   for (int i = 0; i < 5; i++) {
-    ModelInstance* cloud = cloudModel->createInstance();
+    ModelInstance cloud = cloudModel->createInstance();
     float x = distPos(rng);
     float z = distPos(rng);
     float y = distCloudHeight(rng);
-    cloud->setPosition(glm::vec3(x, y, z));
-    cloud->setRotation(glm::vec3(0.0f, 1.0f, 0.0f), distRot(rng));
+    cloud.setPosition(glm::vec3(x, y, z));
+    cloud.setRotation(glm::vec3(0.0f, 1.0f, 0.0f), distRot(rng));
     float scale = distScale(rng) * 2.0f;
-    cloud->setScale(glm::vec3(scale, scale * 0.5f, scale));
+    cloud.setScale(glm::vec3(scale, scale * 0.5f, scale));
     cloudInstances.push_back(cloud);
   }
 
   // Create balloons (5 instances)
   for (int i = 0; i < 5; i++) {
-    ModelInstance* balloon = balloonModel->createInstance();
+    ModelInstance balloon = balloonModel->createInstance();
     float x = distPos(rng);
     float z = distPos(rng);
     float y = distBalloonHeight(rng);
-    balloon->setPosition(glm::vec3(x, y, z));
-    balloon->setRotation(glm::vec3(0.0f, 1.0f, 0.0f), distRot(rng));
+    balloon.setPosition(glm::vec3(x, y, z));
+    balloon.setRotation(glm::vec3(0.0f, 1.0f, 0.0f), distRot(rng));
     float scale = distScale(rng) * 0.3f;
-    balloon->setScale(glm::vec3(scale, scale * 1.2f, scale));
+    balloon.setScale(glm::vec3(scale, scale * 1.2f, scale));
     balloonInstances.push_back(balloon);
   }
 
   // Create ground instance
-  ModelInstance* ground = groundModel->createInstance();
-  ground->setPosition(glm::vec3(0.0f, -2.0f, 0.0f));
-  ground->setScale(glm::vec3(200.0f, 0.1f, 200.0f));
+  ModelInstance ground = groundModel->createInstance();
+  ground.setPosition(glm::vec3(0.0f, -2.0f, 0.0f));
+  ground.setScale(glm::vec3(200.0f, 0.1f, 200.0f));
 
   shader = new Shader();
+  frameUniforms = new FrameUniformBuffer();
+  renderQueue = new RenderQueue();
   std::cout << "Shader initialized" << std::endl;
+
+  // Static scenery is culled on the GPU and never re-uploaded
+  gpuCuller = new GpuCuller();
+  if (gpuCuller->isValid()) {
+    houseModel->setGpuCulling(gpuCuller);
+    std::cout << "GPU culling enabled for houses" << std::endl;
+  }
+
+  // Far trees, clouds and balloons become camera-facing quads from an atlas
+  // baked once their mesh and texture have loaded
+  impostorRenderer = new ImpostorRenderer();
+  if (impostorRenderer->isValid()) {
+    impostorRenderer->setLight(dirLightDirection, dirLightAmbient,
+                               dirLightDiffuse);
+    treeModel->setImpostors(impostorRenderer);
+
+    ImpostorSettings sky;
+    sky.distance = 50.0f;
+    sky.fadeRange = 15.0f;
+    balloonModel->setImpostors(impostorRenderer, sky);
+    sky.opacity = 0.6f;  // Clouds are drawn semi-transparent
+    cloudModel->setImpostors(impostorRenderer, sky);
+
+    // Only these models need the dithered cross-fade in their variants
+    for (Model* model : {treeModel, balloonModel, cloudModel}) {
+      model->setShaderFeatures(model->getShaderFeatures() |
+                               kShaderImpostorFade);
+    }
+    std::cout << "Impostors enabled for trees, clouds and balloons"
+              << std::endl;
+  }
+
+  textureArray = new TextureArray();
+  setMaterialBatching(materialBatching);
 }
 
 void updateCamera() {
   if (!airshipInstance) return;
 
-  glm::vec3 airshipPos = airshipInstance->getPosition();
+  glm::vec3 airshipPos = airshipInstance.getPosition();
   glm::vec3 cameraOffset;
   glm::vec3 cameraTargetOffset;
 
@@ -279,44 +349,52 @@ void updateCamera() {
 }
 
 void updatePresents(float deltaTime) {
-  for (auto it = presents.begin(); it != presents.end();) {
-    if (!it->active) {
-      delete it->instance;
-      it = presents.erase(it);
+  // Survivors are compacted in place, so removal stays linear in the
+  // number of presents
+  size_t alive = 0;
+  for (size_t i = 0; i < presents.size(); i++) {
+    Present& present = presents[i];
+    if (!present.active) {
+      present.instance.destroy();
       continue;
     }
 
     // Update velocity with gravity
-    it->velocity.y += presentGravity * deltaTime;
+    present.velocity.y += presentGravity * deltaTime;
 
     // Update position
-    glm::vec3 currentPos = it->instance->getPosition();
-    currentPos += it->velocity * deltaTime;
-    it->instance->setPosition(currentPos);
+    glm::vec3 currentPos = present.instance.getPosition();
+    currentPos += present.velocity * deltaTime;
+    present.instance.setPosition(currentPos);
 
     // Check if hit the ground
     if (currentPos.y <= presentDespawnHeight) {
-      it->velocity = glm::vec3(0.0f);
-      it->spawnTime = currentTime;
+      present.velocity = glm::vec3(0.0f);
+      if (!present.landed) {
+        present.landed = true;
+        present.spawnTime = currentTime;
+      }
       // Mark for removal after delay
-      if (currentTime - it->spawnTime > presentDespawnTime) {
-        it->active = false;
+      if (currentTime - present.spawnTime > presentDespawnTime) {
+        present.active = false;
       }
     }
 
-    ++it;
+    if (alive != i) presents[alive] = present;
+    alive++;
   }
+  presents.resize(alive);
 }
 
 void dropPresent() {
   if (!airshipInstance || !presentModel) return;
 
-  glm::vec3 airshipPos = airshipInstance->getPosition();
+  glm::vec3 airshipPos = airshipInstance.getPosition();
 
   Present newPresent;
   newPresent.instance = presentModel->createInstance();
-  newPresent.instance->setPosition(airshipPos + glm::vec3(0.0f, -1.0f, 0.0f));
-  newPresent.instance->setScale(glm::vec3(0.2f, 0.2f, 0.2f));
+  newPresent.instance.setPosition(airshipPos + glm::vec3(0.0f, -1.0f, 0.0f));
+  newPresent.instance.setScale(glm::vec3(0.2f, 0.2f, 0.2f));
   newPresent.velocity = glm::vec3(0.0f, 0.0f, 0.0f);
   newPresent.active = true;
   newPresent.spawnTime = currentTime;
@@ -325,101 +403,151 @@ void dropPresent() {
   std::cout << "Present dropped!" << std::endl;
 }
 
+void updateStats(float deltaTime) {
+  const Model::UploadStats& upload = Model::getUploadStats();
+  statsUploadBytes += upload.frameBytes;
+  statsUploadRanges += upload.frameRanges;
+  for (const Model* model : {airshipModel, houseModel, treeModel, cloudModel,
+                             balloonModel, presentModel, groundModel}) {
+    if (!model) continue;
+    statsVisible += model->getCullStats().visible;
+    statsCulled += model->getCullStats().culled;
+    statsTriangles += model->getCullStats().triangles;
+    statsImpostors += model->getCullStats().impostors;
+  }
+  if (renderQueue) {
+    const RenderQueue::Stats& queue = renderQueue->getStats();
+    statsDrawCalls += queue.drawCalls;
+    statsProgramChanges += queue.programChanges;
+    statsTextureChanges += queue.textureChanges;
+  }
+  statsFrames++;
+  statsTimer += deltaTime;
+
+  if (statsTimer >= 1.0f) {
+    if (showStats) {
+      std::cout << "FPS: " << statsFrames
+                << " | instance upload: " << statsUploadBytes / statsFrames
+                << " bytes/frame in " << statsUploadRanges / statsFrames
+                << " ranges | instances: " << statsVisible / statsFrames
+                << " visible, " << statsCulled / statsFrames << " culled"
+                << " | triangles: " << statsTriangles / statsFrames
+                << " | impostors: " << statsImpostors / statsFrames
+                << " | draw calls: " << statsDrawCalls / statsFrames
+                << ", program changes: " << statsProgramChanges / statsFrames
+                << ", texture changes: " << statsTextureChanges / statsFrames;
+      if (shader) {
+        std::cout << " | uniforms: "
+                  << (shader->getUniformUploads() - statsUniformUploadsMark) /
+                         statsFrames
+                  << " set, "
+                  << (shader->getUniformSkips() - statsUniformSkipsMark) /
+                         statsFrames
+                  << " unchanged";
+      }
+      if (statsGpuSamples > 0) {
+        std::cout << " | GPU: " << statsGpuMs / statsGpuSamples << " ms/frame";
+      }
+      std::cout << std::endl;
+    }
+    statsTimer = 0.0f;
+    statsFrames = 0;
+    statsUploadBytes = 0;
+    statsUploadRanges = 0;
+    statsVisible = 0;
+    statsCulled = 0;
+    statsTriangles = 0;
+    statsImpostors = 0;
+    statsDrawCalls = 0;
+    statsProgramChanges = 0;
+    statsTextureChanges = 0;
+    if (shader) {
+      statsUniformUploadsMark = shader->getUniformUploads();
+      statsUniformSkipsMark = shader->getUniformSkips();
+    }
+    statsGpuMs = 0.0;
+    statsGpuSamples = 0;
+  }
+}
+
 void render(float width, float height) {
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  Model::resetFrameUploadStats();
 
   if (!shader) return;
 
-  shader->use();
+  if (gpuTimerQueries[0] == 0) glGenQueries(2, gpuTimerQueries);
+  GLuint gpuTimer = gpuTimerQueries[gpuTimerFrame % 2];
+  if (gpuTimerFrame >= 2) {
+    GLuint available = 0;
+    glGetQueryObjectuiv(gpuTimer, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      GLuint64 elapsed = 0;
+      glGetQueryObjectui64v(gpuTimer, GL_QUERY_RESULT, &elapsed);
+      statsGpuMs += elapsed / 1.0e6;
+      statsGpuSamples++;
+    }
+  }
+  glBeginQuery(GL_TIME_ELAPSED, gpuTimer);
 
   glm::mat4 view = camera->getViewMatrix();
   glm::mat4 projection = camera->getProjectionMatrix(width / height);
 
-  // Set view and projection matrices
-  shader->setMat4("view", view);
-  shader->setMat4("projection", projection);
-
-  // Set view position
-  shader->setVec3("viewPos", camera->position);
-
-  // Set directional light properties
-  shader->setVec3("dirLight.direction", dirLightDirection);
-  shader->setVec3("dirLight.ambient", dirLightAmbient);
-  shader->setVec3("dirLight.diffuse", dirLightDiffuse);
-  shader->setVec3("dirLight.specular", dirLightSpecular);
-
-  // Set time for vertex shader animations
-  shader->setFloat("time", currentTime);
-  shader->setFloat("windStrength", windStrength);
-  shader->setFloat("windFrequency", windFrequency);
-
-  // Draw airship
-  if (airshipModel) {
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, airshipModel->texture);
-    shader->setInt("textureSampler", 0);
-    shader->setInt("animate", 0);  // No animation for airship
-    airshipModel->drawAllInstances();
-  }
-
-  // Draw houses (no animation)
-  if (houseModel) {
-    glBindTexture(GL_TEXTURE_2D, houseModel->texture);
-    shader->setInt("textureSampler", 0);
-    shader->setInt("animate", 0);
-    houseModel->drawAllInstances();
-  }
-
-  // Draw trees (with animation)
-  if (treeModel) {
-    glBindTexture(GL_TEXTURE_2D, treeModel->texture);
-    shader->setInt("textureSampler", 0);
-    shader->setInt("animate", 1);  // Animate trees
-    treeModel->drawAllInstances();
+  // Instances outside the view are not uploaded or drawn
+  Frustum frustum(projection * view);
+
+  // Distant instances switch to simplified meshes once their error shrinks
+  // below a pixel, and to impostors past their impostor distance
+  LodView lodView;
+  lodView.position = camera->position;
+  lodView.pixelsPerUnit = projection[1][1] * height * 0.5f;
+  lodView.view = view;
+  lodView.projection = projection;
+
+  // Camera, light and animation time go to the shader in one buffer upload
+  FrameUniforms frame;
+  frame.view = view;
+  frame.projection = projection;
+  frame.viewPos = glm::vec4(camera->position, 1.0f);
+  frame.lightDirection = glm::vec4(dirLightDirection, 0.0f);
+  frame.lightAmbient = glm::vec4(dirLightAmbient, 0.0f);
+  frame.lightDiffuse = glm::vec4(dirLightDiffuse, 0.0f);
+  frame.lightSpecular = glm::vec4(dirLightSpecular, 0.0f);
+  frame.time = currentTime;
+  frame.windStrength = windStrength;
+  frame.windFrequency = windFrequency;
+  frameUniforms->update(frame);
+
+  // Layers of textures that finished loading since the last frame
+  if (materialBatching) textureArray->update();
+
+  // Models go through the queue sorted by program and texture; clouds are
+  // semi-transparent and drawn last, far to near
+  renderQueue->begin();
+  for (const Model* model : {airshipModel, houseModel, treeModel,
+                             balloonModel, presentModel, groundModel}) {
+    if (model) {
+      renderQueue->submit(*model, RenderPass::Opaque, frustum, lodView);
+    }
   }
-
-  // Draw clouds (semi-transparent)
   if (cloudModel) {
-    glBindTexture(GL_TEXTURE_2D, cloudModel->texture);
-    shader->setInt("textureSampler", 0);
-    shader->setInt("animate", 1);     // Animate clouds
-    shader->setFloat("alpha", 0.6f);  // Semi-transparent
-    cloudModel->drawAllInstances();
-    shader->setFloat("alpha", 1.0f);  // Reset alpha
-  }
-
-  // Draw balloons (with gentle animation)
-  if (balloonModel) {
-    glBindTexture(GL_TEXTURE_2D, balloonModel->texture);
-    shader->setInt("textureSampler", 0);
-    shader->setInt("animate", 1);  // Animate balloons
-    balloonModel->drawAllInstances();
-  }
-
-  // Draw presents
-  if (presentModel) {
-    glBindTexture(GL_TEXTURE_2D, presentModel->texture);
-    shader->setInt("textureSampler", 0);
-    shader->setInt("animate", 0);  // No animation for presents
-    presentModel->drawAllInstances();
-  }
-
-  // Draw ground
-  if (groundModel) {
-    glBindTexture(GL_TEXTURE_2D, groundModel->texture);
-    shader->setInt("textureSampler", 0);
-    shader->setInt("animate", 0);
-    groundModel->drawAllInstances();
+    renderQueue->submit(*cloudModel, RenderPass::Transparent, frustum, lodView,
+                        0.6f);
   }
+  renderQueue->execute(*shader);
 
   glBindTexture(GL_TEXTURE_2D, 0);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
   glUseProgram(0);
+
+  glEndQuery(GL_TIME_ELAPSED);
+  gpuTimerFrame++;
 }
 
 void handleInput(float deltaTime) {
   if (!airshipInstance) return;
 
-  glm::vec3 airshipPos = airshipInstance->getPosition();
+  glm::vec3 airshipPos = airshipInstance.getPosition();
   glm::vec3 movement(0.0f);
 
   // Horizontal movement (WASD)
@@ -468,7 +596,7 @@ void handleInput(float deltaTime) {
   airshipPos.y = glm::clamp(airshipPos.y, 5.0f, 50.0f);
   airshipPos.z = glm::clamp(airshipPos.z, -80.0f, 80.0f);
 
-  airshipInstance->setPosition(airshipPos);
+  airshipInstance.setPosition(airshipPos);
 
   // Camera offset adjustment with arrows
   static bool arrowAdjustMode = false;
@@ -563,6 +691,8 @@ int main() {
   std::cout << "\n=== AIRSHIP DELIVERY GAME ===" << std::endl;
   std::cout << std::endl;
 
+  auto startTime = std::chrono::steady_clock::now();
+
   initGL();
   initResources();
 
@@ -583,6 +713,8 @@ int main() {
   std::cout << " LShift + Arrows - Adjust camera offset (follow mode)"
             << std::endl;
   std::cout << " Backspace    - Reset camera offset" << std::endl;
+  std::cout << " F1           - Toggle performance stats" << std::endl;
+  std::cout << " F2           - Toggle texture array batching" << std::endl;
   std::cout << " ESC          - Exit" << std::endl;
   std::cout << std::endl;
   std::cout << "Game features:" << std::endl;
@@ -594,6 +726,8 @@ int main() {
 
   sf::Clock clock;
   bool running = true;
+  bool firstFrame = true;
+  bool assetsPending = true;
 
   while (running && window.isOpen()) {
     sf::Event event;
@@ -604,11 +738,42 @@ int main() {
         running = false;
       }
 
+      if (event.type == sf::Event::KeyPressed &&
+          event.key.code == sf::Keyboard::F1) {
+        showStats = !showStats;
+      }
+
+      if (event.type == sf::Event::KeyPressed &&
+          event.key.code == sf::Keyboard::F2) {
+        setMaterialBatching(!materialBatching);
+        std::cout << "Texture array batching "
+                  << (materialBatching ? "on" : "off") << std::endl;
+      }
+
       if (event.type == sf::Event::Resized) {
         glViewport(0, 0, event.size.width, event.size.height);
       }
     }
 
+    // Upload assets finished by the background loader since the last frame
+    AsyncLoader::instance().processUploads();
+    if (assetsPending && AsyncLoader::instance().getPendingCount() == 0) {
+      assetsPending = false;
+      std::cout << "All assets loaded in "
+                << std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count()
+                << " ms" << std::endl;
+      if (materialBatching) {
+        // With every texture in, the array takes its final format and
+        // unloads the source textures; report it before the registry
+        textureArray->update();
+        textureArray->printStats();
+      }
+      AssetRegistry::instance().printStats();
+      GeometryArena::instance().printStats();
+    }
+
     float deltaTime = clock.restart().asSeconds();
     currentTime += deltaTime;
 
@@ -616,11 +781,30 @@ int main() {
     updateCamera();
     updatePresents(deltaTime);
     render(window.getSize().x, window.getSize().y);
+    updateStats(deltaTime);
     window.display();
+
+    if (firstFrame) {
+      firstFrame = false;
+      std::cout << "Time to first frame: "
+                << std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count()
+                << " ms" << std::endl;
+    }
   }
 
   // Cleanup
+  AsyncLoader::instance().shutdown();
+
+  // Instances are handles into their models' pools and need no cleanup
+  presents.clear();
+
+  if (gpuTimerQueries[0] != 0) glDeleteQueries(2, gpuTimerQueries);
   delete shader;
+  delete frameUniforms;
+  delete renderQueue;
+  delete textureArray;
   delete camera;
   delete airshipModel;
   delete houseModel;
@@ -629,12 +813,11 @@ int main() {
   delete balloonModel;
   delete presentModel;
   delete groundModel;
-
-  // Clean up presents
-  for (auto& present : presents) {
-    delete present.instance;
-  }
-  presents.clear();
+  delete gpuCuller;
+  delete impostorRenderer;
+  // Meshes have returned their ranges; free the shared buffers while the
+  // context is alive
+  GeometryArena::instance().shutdown();
 
   window.close();
   std::cout << "Program finished" << std::endl;
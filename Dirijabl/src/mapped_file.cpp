@@ -0,0 +1,202 @@
+#include "mapped_file.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_POSIX 1
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string& filename) {
+  close();
+
+#ifdef MAPPED_FILE_POSIX
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  length = static_cast<size_t>(st.st_size);
+  if (length > 0) {
+    void* ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+      ::close(fd);
+      length = 0;
+      return false;
+    }
+    // Файл читается строго последовательно
+    madvise(ptr, length, MADV_SEQUENTIAL);
+    begin = static_cast<const char*>(ptr);
+    mapped = true;
+  }
+  // Отображение остаётся валидным и после закрытия дескриптора
+  ::close(fd);
+#else
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  if (!file.is_open()) return false;
+
+  length = static_cast<size_t>(file.tellg());
+  buffer.resize(length);
+  file.seekg(0);
+  if (length > 0 && !file.read(buffer.data(), length)) {
+    buffer.clear();
+    length = 0;
+    return false;
+  }
+  begin = buffer.data();
+#endif
+
+  opened = true;
+  return true;
+}
+
+void MappedFile::close() {
+#ifdef MAPPED_FILE_POSIX
+  if (mapped) {
+    munmap(const_cast<char*>(begin), length);
+  }
+#endif
+  buffer.clear();
+  begin = nullptr;
+  length = 0;
+  opened = false;
+  mapped = false;
+}
+
+// Проверить файл на доступность.
+bool checkFile(const std::string& filename) {
+  std::error_code ec;
+  auto file_status = std::filesystem::status(filename, ec);
+
+  if (ec) {
+    std::cerr << "File check error: " << ec.message() << std::endl;
+    return false;
+  }
+
+  if (!std::filesystem::exists(file_status)) {
+    std::cerr << "File doesn't exist: " << filename << std::endl;
+    return false;
+  }
+
+  if (std::filesystem::is_directory(file_status)) {
+    std::cerr << "Path is a directory, not a file: " << filename << std::endl;
+    return false;
+  }
+
+  try {
+    auto file_size = std::filesystem::file_size(filename);
+    if (file_size == 0) {
+      std::cerr << "File is empty: " << filename << std::endl;
+      return false;
+    }
+  } catch (const std::filesystem::filesystem_error& e) {
+    std::cerr << "Couldn't get file size: " << e.what() << std::endl;
+  }
+
+  return true;
+}
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed) {
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  uint64_t h = seed;
+  for (size_t i = 0; i < size; i++) {
+    h ^= bytes[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+bool fileStamp(const std::string& filename, uint64_t& size, int64_t& mtime) {
+  std::error_code ec;
+  auto fileSize = std::filesystem::file_size(filename, ec);
+  if (ec) return false;
+  auto writeTime = std::filesystem::last_write_time(filename, ec);
+  if (ec) return false;
+
+  size = static_cast<uint64_t>(fileSize);
+  mtime = static_cast<int64_t>(writeTime.time_since_epoch().count());
+  return true;
+}
+
+bool fileHash(const std::string& filename, uint64_t& hash) {
+  MappedFile file(filename);
+  if (!file.isOpen()) return false;
+  hash = hashBytes(file.data(), file.size());
+  return true;
+}
+
+bool patchFile(const std::string& filename, size_t offset, const void* data,
+               size_t size) {
+  std::fstream file(filename,
+                    std::ios::binary | std::ios::in | std::ios::out);
+  if (!file.is_open()) return false;
+  file.seekp(static_cast<std::streamoff>(offset));
+  file.write(static_cast<const char*>(data),
+             static_cast<std::streamsize>(size));
+  return static_cast<bool>(file.flush());
+}
+
+bool sourceMatches(const std::string& filename, uint64_t size, int64_t mtime,
+                   uint64_t hash, const std::string& cachePath,
+                   size_t mtimeOffset) {
+  uint64_t currentSize = 0;
+  int64_t currentMtime = 0;
+  if (!fileStamp(filename, currentSize, currentMtime)) return false;
+  if (currentSize != size) return false;
+  if (currentMtime == mtime) return true;
+
+  // Время изменения могло поменяться без изменения содержимого
+  uint64_t contentHash = 0;
+  if (!fileHash(filename, contentHash) || contentHash != hash) return false;
+  if (!patchFile(cachePath, mtimeOffset, &currentMtime,
+                 sizeof(currentMtime))) {
+    std::cerr << "Не удалось обновить время исходника в кэше: " << cachePath
+              << std::endl;
+  }
+  return true;
+}
+
+bool writeFileAtomically(const std::string& filename,
+                         std::initializer_list<FileChunk> chunks) {
+  const std::string tmpPath = filename + ".tmp";
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+      std::cerr << "Не получилось записать файл: " << filename << std::endl;
+      return false;
+    }
+    for (const FileChunk& chunk : chunks) {
+      out.write(static_cast<const char*>(chunk.data),
+                static_cast<std::streamsize>(chunk.size));
+    }
+    if (!out.good()) {
+      std::cerr << "Ошибка записи файла: " << filename << std::endl;
+      out.close();
+      std::remove(tmpPath.c_str());
+      return false;
+    }
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, filename, ec);
+  if (ec) {
+    std::cerr << "Не получилось записать файл " << filename << ": "
+              << ec.message() << std::endl;
+    std::remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,284 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <filesystem>
+
+// Прочитать меш из obj-файла или его кэша.
+bool MeshData::read(const std::string& filename,
+                    const ModelLoadOptions& options) {
+  std::cout << "Загружаем модель из " << filename << std::endl;
+
+  if (!checkFile(filename)) {
+    makeFallback();
+    return false;
+  }
+
+  const unsigned int lodLevels =
+      std::clamp(options.lodLevels, 1u, kMaxLodLevels);
+  if (options.useMeshCache &&
+      cache.open(filename, options.weldEpsilon, lodLevels)) {
+    fromCache = true;
+    fallback = false;
+    weldStats = {};
+    weldStats.outputVertices = cache.getVertexCount();
+    lods.assign(cache.getLods(), cache.getLods() + cache.getLodCount());
+    std::cout << "Модель загружена из кэша " << MeshCache::cachePath(filename)
+              << ": " << cache.getVertexCount() << " вершин, "
+              << lods[0].indexCount << " индексов, " << lods.size()
+              << " уровней детализации" << std::endl;
+    return true;
+  }
+
+  MappedFile file(filename);
+  if (!file.isOpen()) {
+    std::cerr << "Не получилось открыть файл: " << filename << std::endl;
+
+    // Проверка доступа к файлу
+    auto perms = std::filesystem::status(filename).permissions();
+    std::string permission_error;
+
+    if ((perms & std::filesystem::perms::owner_read) ==
+            std::filesystem::perms::none &&
+        (perms & std::filesystem::perms::group_read) ==
+            std::filesystem::perms::none &&
+        (perms & std::filesystem::perms::others_read) ==
+            std::filesystem::perms::none) {
+      permission_error = "Нет прав на чтение файла";
+    } else if ((perms & std::filesystem::perms::owner_read) ==
+               std::filesystem::perms::none) {
+      permission_error = "Нет прав пользователя на чтение";
+    }
+
+    if (!permission_error.empty()) {
+      std::cerr << permission_error << std::endl;
+    }
+    makeFallback();
+    return false;
+  }
+
+  // Приступаем к чтению данных: файл разбирается прямо в отображённой памяти
+  auto parseStart = std::chrono::steady_clock::now();
+
+  ObjData obj;
+  std::string error;
+  bool parsed =
+      options.threads == 1
+          ? parseObj(file.data(), file.data() + file.size(), obj, error)
+          : parseObjParallel(file.data(), file.data() + file.size(), obj,
+                             error, ThreadPool::shared(), options.threads);
+  if (!parsed ||
+      !buildObjMesh(obj, options.weldEpsilon, vertices, indices, weldStats,
+                    error)) {
+    std::cerr << "Ошибка разбора " << filename << ": " << error << std::endl;
+    makeFallback();
+    return false;
+  }
+
+  auto parseTime = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - parseStart)
+                       .count();
+  file.close();
+
+  std::cout << "Разбор obj: " << parseTime << " мс" << std::endl;
+  std::cout << "Склейка вершин: " << weldStats.inputVertices << " углов -> "
+            << weldStats.outputVertices << " вершин (по индексам: "
+            << weldStats.tripleHits << ", по значению: " << weldStats.valueHits
+            << ")" << std::endl;
+
+  if (vertices.empty()) {
+    std::cerr << "Модель пуста!" << std::endl;
+    makeFallback();
+    return false;
+  }
+
+  fallback = false;
+
+  auto lodStart = std::chrono::steady_clock::now();
+  buildMeshLods(vertices, indices, lodLevels, lods);
+  auto lodTime = std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - lodStart)
+                     .count();
+  std::cout << "Уровни детализации (" << lodTime << " мс):";
+  for (const MeshLod& lod : lods) {
+    std::cout << " " << lod.indexCount / 3;
+  }
+  std::cout << " треугольников" << std::endl;
+
+  // Порядок треугольников и вершин под кэш вершин GPU
+  auto optimizeStart = std::chrono::steady_clock::now();
+  VertexCacheStats cacheBefore, cacheAfter;
+  optimizeMesh(vertices, indices, lods, cacheBefore, cacheAfter);
+  auto optimizeTime = std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - optimizeStart)
+                          .count();
+  std::cout << "Кэш вершин (" << optimizeTime << " мс): ACMR "
+            << cacheBefore.acmr << " -> " << cacheAfter.acmr << ", ATVR "
+            << cacheBefore.atvr << " -> " << cacheAfter.atvr << std::endl;
+
+  if (options.useMeshCache &&
+      MeshCache::write(filename, options.weldEpsilon, lodLevels, vertices,
+                       indices, lods)) {
+    std::cout << "Меш сохранён в " << MeshCache::cachePath(filename)
+              << std::endl;
+  }
+
+  std::cout << "Модель загружена: " << vertices.size() << " вершин, "
+            << lods[0].indexCount << " индексов" << std::endl;
+  return true;
+}
+
+void MeshData::makeFallback() {
+  std::cout << "Создан куб вместо модели" << std::endl;
+
+  vertices = {
+      // Front
+      {{-0.5f, -0.5f, 0.5f}, {0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+      {{0.5f, -0.5f, 0.5f}, {1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+      {{0.5f, 0.5f, 0.5f}, {1.0f, 1.0f}, {0.0f, 0.0f, 1.0f}},
+      {{-0.5f, 0.5f, 0.5f}, {0.0f, 1.0f}, {0.0f, 0.0f, 1.0f}},
+      // Back
+      {{-0.5f, -0.5f, -0.5f}, {1.0f, 0.0f}, {0.0f, 0.0f, -1.0f}},
+      {{0.5f, -0.5f, -0.5f}, {0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}},
+      {{0.5f, 0.5f, -0.5f}, {0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}},
+      {{-0.5f, 0.5f, -0.5f}, {1.0f, 1.0f}, {0.0f, 0.0f, -1.0f}},
+  };
+
+  indices = {
+      0, 1, 2, 0, 2, 3,  // Front
+      4, 6, 5, 4, 7, 6,  // Back
+      0, 4, 5, 0, 5, 1,  // Bottom
+      2, 6, 7, 2, 7, 3,  // Top
+      0, 3, 7, 0, 7, 4,  // Left
+      1, 5, 6, 1, 6, 2,  // Right
+  };
+
+  lods.assign(1, MeshLod());
+  lods[0].indexCount = static_cast<uint32_t>(indices.size());
+
+  fallback = true;
+  fromCache = false;
+  cache.close();
+  weldStats = {};
+}
+
+bool Mesh::load(const std::string& filename, const ModelLoadOptions& options) {
+  packed = options.packVertices;
+  MeshData data;
+  bool ok = data.read(filename, options);
+  apply(data);
+  return ok;
+}
+
+bool Mesh::createFallback() {
+  MeshData data;
+  data.makeFallback();
+  apply(data);
+  return true;
+}
+
+bool Mesh::beginAsyncLoad(const std::string& filename,
+                          const ModelLoadOptions& options) {
+  std::cout << "Модель загружается в фоне: " << filename << std::endl;
+
+  // Куб сразу заливается в том же формате, что и будущая модель
+  packed = options.packVertices;
+
+  bool exists = checkFile(filename);
+  createFallback();
+  // Пока файл не прочитан, куб только замещает модель
+  fallback = !exists;
+  ready = !exists;
+  return exists;
+}
+
+void Mesh::apply(MeshData& data) {
+  size_t vertexCount = 0;
+  size_t totalIndices = 0;
+  if (data.fromCache) {
+    // Данные уходят в GPU прямо из отображённого файла, копии на CPU
+    // не остаётся: vertices и indices пусты
+    const MeshCache& cache = data.cache;
+    vertexCount = cache.getVertexCount();
+    totalIndices = cache.getIndexCount();
+    bounds = Bounds::fromVertices(cache.getVertices(), vertexCount);
+    upload(cache.getVertices(), vertexCount, cache.getIndices(),
+           totalIndices);
+    lods.assign(cache.getLods(), cache.getLods() + cache.getLodCount());
+    data.cache.close();
+  } else {
+    vertices = std::move(data.vertices);
+    indices = std::move(data.indices);
+    lods = std::move(data.lods);
+    vertexCount = vertices.size();
+    totalIndices = indices.size();
+    bounds = Bounds::fromVertices(vertices.data(), vertexCount);
+    upload(vertices.data(), vertexCount, indices.data(), totalIndices);
+  }
+
+  if (lods.empty()) {
+    lods.assign(1, MeshLod());
+    lods[0].indexCount = static_cast<uint32_t>(totalIndices);
+  }
+  indexCount = lods[0].indexCount;
+  weldStats = data.weldStats;
+  fallback = data.fallback;
+  ready = true;
+
+  if (!fallback) {
+    // Во сколько раз меньше памяти и выборки из неё, чем у несжатого меша
+    const size_t plainBytes = vertexCount * sizeof(ModelVertex) +
+                              totalIndices * sizeof(GLuint);
+    std::cout << "Меш в GPU: " << gpuBytes / 1024 << " КБ вместо "
+              << plainBytes / 1024 << " КБ, вершина "
+              << (packed ? sizeof(PackedVertex) : sizeof(ModelVertex))
+              << " байт, индексы " << getIndexSize() * 8 << " бит"
+              << std::endl;
+  }
+}
+
+Mesh::~Mesh() {
+  if (isUploaded()) GeometryArena::instance().release(arenaHandle);
+}
+
+void Mesh::upload(const ModelVertex* vertexData, size_t numVertices,
+                  const GLuint* indexData, size_t numIndices) {
+  // Вершины; сжатые квантуются по ограничивающему параллелепипеду
+  std::vector<PackedVertex> packedVertices;
+  const void* vertexSource = vertexData;
+  size_t vertexBytes = 0;
+  if (packed) {
+    decode = makePositionDecode(bounds);
+    packVertices(vertexData, numVertices, decode, packedVertices);
+    vertexSource = packedVertices.data();
+    vertexBytes = numVertices * sizeof(PackedVertex);
+  } else {
+    decode = PositionDecode();
+    vertexBytes = numVertices * sizeof(ModelVertex);
+  }
+
+  // Полигоны через индексы, 16-битные, если ими адресуются все вершины.
+  // Индексы отсчитываются от первой вершины меша, поэтому положение меша
+  // в арене на них не влияет.
+  indexType = numVertices <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  std::vector<GLushort> shortIndices;
+  const void* indexSource = indexData;
+  if (indexType == GL_UNSIGNED_SHORT) {
+    shortIndices.assign(indexData, indexData + numIndices);
+    indexSource = shortIndices.data();
+  }
+  const size_t indexBytes = numIndices * getIndexSize();
+
+  // Прежний диапазон (куб-заместитель) освобождается первым, чтобы модель
+  // из файла могла занять его место
+  GeometryArena& arena = GeometryArena::instance();
+  if (isUploaded()) arena.release(arenaHandle);
+  arenaHandle =
+      arena.allocate(packed, indexType == GL_UNSIGNED_SHORT, vertexSource,
+                     numVertices, indexSource, numIndices);
+
+  gpuBytes = vertexBytes + indexBytes;
+}
+
+void Mesh::setupAttributes() const {
+  GeometryArena::instance().setupAttributes(arenaHandle);
+}
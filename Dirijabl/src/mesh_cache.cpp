@@ -0,0 +1,147 @@
+#include "mesh_cache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr char kMagic[4] = {'D', 'M', 'S', 'H'};
+
+}  // namespace
+
+std::string MeshCache::cachePath(const std::string& objPath) {
+  return objPath + ".dmesh";
+}
+
+bool MeshCache::open(const std::string& objPath, float weldEpsilon,
+                     unsigned int lodLevels) {
+  close();
+
+  const std::string path = cachePath(objPath);
+  if (!file.open(path)) return false;
+
+  if (file.size() < sizeof(DMeshHeader)) {
+    close();
+    return false;
+  }
+
+  const DMeshHeader* h = reinterpret_cast<const DMeshHeader*>(file.data());
+  const size_t payloadSize =
+      static_cast<size_t>(h->vertexCount) * sizeof(ModelVertex) +
+      static_cast<size_t>(h->indexCount) * sizeof(uint32_t) +
+      static_cast<size_t>(h->lodCount) * sizeof(MeshLod);
+
+  if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 ||
+      h->version != kDMeshVersion || h->vertexStride != sizeof(ModelVertex) ||
+      h->weldEpsilon != weldEpsilon || h->lodLevels != lodLevels ||
+      h->lodCount == 0 || file.size() != sizeof(DMeshHeader) + payloadSize) {
+    std::cout << "Кэш меша устарел (формат): " << path << std::endl;
+    close();
+    return false;
+  }
+
+  if (!sourceMatches(objPath, h->sourceSize, h->sourceMtime, h->sourceHash,
+                     path, offsetof(DMeshHeader, sourceMtime))) {
+    std::cout << "Кэш меша устарел (исходник изменён): " << path << std::endl;
+    close();
+    return false;
+  }
+
+  const char* payload = file.data() + sizeof(DMeshHeader);
+  if (hashBytes(payload, payloadSize) != h->payloadHash) {
+    std::cerr << "Кэш меша повреждён: " << path << std::endl;
+    close();
+    return false;
+  }
+
+  header = h;
+  vertices = reinterpret_cast<const ModelVertex*>(payload);
+  indices = reinterpret_cast<const uint32_t*>(
+      payload + static_cast<size_t>(h->vertexCount) * sizeof(ModelVertex));
+  lods = reinterpret_cast<const MeshLod*>(indices + h->indexCount);
+
+  // Уровни должны лежать внутри индексов
+  for (uint32_t i = 0; i < h->lodCount; i++) {
+    if (static_cast<uint64_t>(lods[i].indexOffset) + lods[i].indexCount >
+        h->indexCount) {
+      std::cerr << "Кэш меша повреждён (уровни): " << path << std::endl;
+      close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void MeshCache::close() {
+  file.close();
+  header = nullptr;
+  vertices = nullptr;
+  indices = nullptr;
+  lods = nullptr;
+}
+
+glm::vec3 MeshCache::getBoundsMin() const {
+  if (!header) return glm::vec3(0.0f);
+  return glm::vec3(header->boundsMin[0], header->boundsMin[1],
+                   header->boundsMin[2]);
+}
+
+glm::vec3 MeshCache::getBoundsMax() const {
+  if (!header) return glm::vec3(0.0f);
+  return glm::vec3(header->boundsMax[0], header->boundsMax[1],
+                   header->boundsMax[2]);
+}
+
+bool MeshCache::write(const std::string& objPath, float weldEpsilon,
+                      unsigned int lodLevels,
+                      const std::vector<ModelVertex>& vertices,
+                      const std::vector<unsigned int>& indices,
+                      const std::vector<MeshLod>& lods) {
+  static_assert(sizeof(DMeshHeader) % alignof(ModelVertex) == 0,
+                "Вершины в .dmesh должны быть выровнены");
+  static_assert(sizeof(unsigned int) == sizeof(uint32_t),
+                "Индексы в .dmesh хранятся как uint32");
+  static_assert(sizeof(MeshLod) == 12, "Уровень в .dmesh занимает 12 байт");
+
+  DMeshHeader h = {};
+  std::memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kDMeshVersion;
+  h.vertexStride = sizeof(ModelVertex);
+  h.vertexCount = static_cast<uint32_t>(vertices.size());
+  h.indexCount = static_cast<uint32_t>(indices.size());
+  h.weldEpsilon = weldEpsilon;
+  h.lodLevels = lodLevels;
+  h.lodCount = static_cast<uint32_t>(lods.size());
+
+  if (!fileStamp(objPath, h.sourceSize, h.sourceMtime) ||
+      !fileHash(objPath, h.sourceHash)) {
+    return false;
+  }
+
+  glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+  if (!vertices.empty()) {
+    boundsMin = boundsMax = vertices[0].position;
+    for (const auto& v : vertices) {
+      boundsMin = glm::min(boundsMin, v.position);
+      boundsMax = glm::max(boundsMax, v.position);
+    }
+  }
+  for (int i = 0; i < 3; i++) {
+    h.boundsMin[i] = boundsMin[i];
+    h.boundsMax[i] = boundsMax[i];
+  }
+
+  const size_t vertexBytes = vertices.size() * sizeof(ModelVertex);
+  const size_t indexBytes = indices.size() * sizeof(uint32_t);
+  const size_t lodBytes = lods.size() * sizeof(MeshLod);
+  h.payloadHash = hashBytes(vertices.data(), vertexBytes);
+  h.payloadHash = hashBytes(indices.data(), indexBytes, h.payloadHash);
+  h.payloadHash = hashBytes(lods.data(), lodBytes, h.payloadHash);
+
+  return writeFileAtomically(cachePath(objPath),
+                             {{&h, sizeof(h)},
+                              {vertices.data(), vertexBytes},
+                              {indices.data(), indexBytes},
+                              {lods.data(), lodBytes}});
+}
@@ -0,0 +1,319 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Веса Форсайта: LRU-кэш на 32 вершины, вершины последнего треугольника
+// получают фиксированный вес, остальные — убывающий с позицией. Вершины,
+// у которых осталось мало треугольников, поднимаются, чтобы их
+// доиспользовать и не оставлять одиночных треугольников на потом.
+constexpr int kScoreCacheSize = 32;
+constexpr float kCacheDecayPower = 1.5f;
+constexpr float kLastTriangleScore = 0.75f;
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+// Допустимый рост ACMR при сортировке кластеров по перерисовке
+constexpr float kOverdrawThreshold = 1.05f;
+
+float vertexScore(int cachePosition, unsigned int remaining) {
+  // Вершина больше не нужна ни одному треугольнику
+  if (remaining == 0) return -1.0f;
+
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+    if (cachePosition < 3) {
+      score = kLastTriangleScore;
+    } else {
+      const float scale = 1.0f / (kScoreCacheSize - 3);
+      score = std::pow(1.0f - (cachePosition - 3) * scale, kCacheDecayPower);
+    }
+  }
+  return score + kValenceBoostScale *
+                     std::pow(static_cast<float>(remaining),
+                              -kValenceBoostPower);
+}
+
+}  // namespace
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices,
+                                    size_t indexCount, size_t vertexCount,
+                                    unsigned int cacheSize) {
+  VertexCacheStats stats;
+  const size_t triangleCount = indexCount / 3;
+  if (triangleCount == 0 || vertexCount == 0) return stats;
+
+  // Вершина в кэше, если с её записи прошло не больше cacheSize промахов
+  std::vector<unsigned int> timestamps(vertexCount, 0);
+  std::vector<bool> used(vertexCount, false);
+  unsigned int time = cacheSize + 1;
+  size_t misses = 0;
+  size_t unique = 0;
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    const unsigned int v = indices[i];
+    if (!used[v]) {
+      used[v] = true;
+      unique++;
+    }
+    if (time - timestamps[v] > cacheSize) {
+      timestamps[v] = time++;
+      misses++;
+    }
+  }
+
+  stats.acmr = static_cast<float>(misses) / triangleCount;
+  stats.atvr = static_cast<float>(misses) / unique;
+  return stats;
+}
+
+void optimizeVertexCache(unsigned int* indices, size_t indexCount,
+                         size_t vertexCount) {
+  const size_t triangleCount = indexCount / 3;
+  if (triangleCount < 2 || vertexCount == 0) return;
+
+  // Невыданные треугольники при каждой вершине: у вершины v они лежат в
+  // adjacency[adjacencyStart[v] .. adjacencyStart[v] + remaining[v])
+  std::vector<unsigned int> remaining(vertexCount, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++) remaining[indices[i]]++;
+  std::vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+  for (size_t v = 0; v < vertexCount; v++) {
+    adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+  }
+  std::vector<unsigned int> adjacency(triangleCount * 3);
+  {
+    std::vector<unsigned int> fill(adjacencyStart.begin(),
+                                   adjacencyStart.end() - 1);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+      adjacency[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+  }
+
+  std::vector<float> vertexScores(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    vertexScores[v] = vertexScore(-1, remaining[v]);
+  }
+
+  long best = -1;
+  float bestScore = -1.0f;
+  for (size_t t = 0; t < triangleCount; t++) {
+    const unsigned int* tri = &indices[t * 3];
+    const float score =
+        vertexScores[tri[0]] + vertexScores[tri[1]] + vertexScores[tri[2]];
+    if (score > bestScore) {
+      bestScore = score;
+      best = static_cast<long>(t);
+    }
+  }
+
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<unsigned int> result(triangleCount * 3);
+  unsigned int cache[kScoreCacheSize + 3];
+  int cacheCount = 0;
+  size_t cursor = 0;
+
+  for (size_t out = 0; out < triangleCount; out++) {
+    // Кэш ничего не предложил: следующий невыданный по исходному порядку
+    if (best < 0) {
+      while (emitted[cursor]) cursor++;
+      best = static_cast<long>(cursor);
+    }
+
+    const unsigned int tri[3] = {indices[best * 3], indices[best * 3 + 1],
+                                 indices[best * 3 + 2]};
+    emitted[best] = true;
+    result[out * 3] = tri[0];
+    result[out * 3 + 1] = tri[1];
+    result[out * 3 + 2] = tri[2];
+
+    // Убрать треугольник из списков его вершин
+    for (unsigned int v : tri) {
+      unsigned int* begin = &adjacency[adjacencyStart[v]];
+      unsigned int* end = begin + remaining[v];
+      unsigned int* it =
+          std::find(begin, end, static_cast<unsigned int>(best));
+      if (it != end) {
+        std::swap(*it, *(end - 1));
+        remaining[v]--;
+      }
+    }
+
+    // Вершины треугольника в начало кэша, прежние сдвигаются
+    unsigned int newCache[kScoreCacheSize + 3];
+    int newCount = 0;
+    for (unsigned int v : tri) newCache[newCount++] = v;
+    for (int i = 0; i < cacheCount; i++) {
+      const unsigned int v = cache[i];
+      if (v != tri[0] && v != tri[1] && v != tri[2]) {
+        newCache[newCount++] = v;
+      }
+    }
+    // Вытесненные теряют вес кэша
+    for (int i = kScoreCacheSize; i < newCount; i++) {
+      vertexScores[newCache[i]] = vertexScore(-1, remaining[newCache[i]]);
+    }
+    cacheCount = std::min(newCount, kScoreCacheSize);
+    std::copy(newCache, newCache + cacheCount, cache);
+
+    // Пересчитать веса вершин кэша и выбрать лучший из их треугольников
+    for (int i = 0; i < cacheCount; i++) {
+      vertexScores[cache[i]] = vertexScore(i, remaining[cache[i]]);
+    }
+    best = -1;
+    bestScore = 0.0f;
+    for (int i = 0; i < cacheCount; i++) {
+      const unsigned int v = cache[i];
+      const unsigned int* begin = &adjacency[adjacencyStart[v]];
+      for (const unsigned int* it = begin; it != begin + remaining[v]; it++) {
+        const unsigned int* candidate = &indices[*it * 3];
+        const float score = vertexScores[candidate[0]] +
+                            vertexScores[candidate[1]] +
+                            vertexScores[candidate[2]];
+        if (score > bestScore) {
+          bestScore = score;
+          best = static_cast<long>(*it);
+        }
+      }
+    }
+  }
+
+  std::copy(result.begin(), result.end(), indices);
+}
+
+void optimizeOverdraw(unsigned int* indices, size_t indexCount,
+                      const std::vector<ModelVertex>& vertices,
+                      float threshold) {
+  const size_t triangleCount = indexCount / 3;
+  if (triangleCount < 2 || vertices.empty()) return;
+
+  const VertexCacheStats before =
+      analyzeVertexCache(indices, indexCount, vertices.size());
+
+  // Кластер начинается с треугольника, не нашедшего в кэше ни одной
+  // вершины: перестановка кластеров целиком почти не трогает ACMR
+  std::vector<size_t> clusterStart;
+  {
+    std::vector<unsigned int> timestamps(vertices.size(), 0);
+    unsigned int time = kVertexCacheSize + 1;
+    for (size_t t = 0; t < triangleCount; t++) {
+      int misses = 0;
+      for (int k = 0; k < 3; k++) {
+        const unsigned int v = indices[t * 3 + k];
+        if (time - timestamps[v] > kVertexCacheSize) {
+          timestamps[v] = time++;
+          misses++;
+        }
+      }
+      if (t == 0 || misses == 3) clusterStart.push_back(t);
+    }
+  }
+  if (clusterStart.size() < 2) return;
+  clusterStart.push_back(triangleCount);
+
+  // Центр меша с весом по площади
+  glm::vec3 meshCenter(0.0f);
+  float meshArea = 0.0f;
+  for (size_t t = 0; t < triangleCount; t++) {
+    const glm::vec3& p0 = vertices[indices[t * 3]].position;
+    const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+    const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+    const float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+    meshCenter += (p0 + p1 + p2) * (area / 3.0f);
+    meshArea += area;
+  }
+  if (meshArea <= 0.0f) return;
+  meshCenter /= meshArea;
+
+  // Кластеры, смотрящие наружу, закрывают остальные и рисуются раньше
+  struct Cluster {
+    size_t first;
+    size_t end;
+    float outward;
+  };
+  std::vector<Cluster> clusters;
+  clusters.reserve(clusterStart.size() - 1);
+  for (size_t c = 0; c + 1 < clusterStart.size(); c++) {
+    glm::vec3 center(0.0f);
+    glm::vec3 normal(0.0f);
+    float area = 0.0f;
+    for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+      const glm::vec3& p0 = vertices[indices[t * 3]].position;
+      const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+      const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+      const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+      const float a = glm::length(n);
+      center += (p0 + p1 + p2) * (a / 3.0f);
+      normal += n;
+      area += a;
+    }
+    float outward = 0.0f;
+    const float normalLength = glm::length(normal);
+    if (area > 0.0f && normalLength > 0.0f) {
+      outward = glm::dot(center / area - meshCenter, normal / normalLength);
+    }
+    clusters.push_back({clusterStart[c], clusterStart[c + 1], outward});
+  }
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const Cluster& a, const Cluster& b) {
+                     return a.outward > b.outward;
+                   });
+
+  std::vector<unsigned int> sorted;
+  sorted.reserve(triangleCount * 3);
+  for (const Cluster& cluster : clusters) {
+    sorted.insert(sorted.end(), indices + cluster.first * 3,
+                  indices + cluster.end * 3);
+  }
+
+  const VertexCacheStats after =
+      analyzeVertexCache(sorted.data(), sorted.size(), vertices.size());
+  if (after.acmr > before.acmr * threshold) return;
+  std::copy(sorted.begin(), sorted.end(), indices);
+}
+
+void optimizeVertexFetch(std::vector<ModelVertex>& vertices,
+                         std::vector<unsigned int>& indices) {
+  const unsigned int unused = ~0u;
+  std::vector<unsigned int> remap(vertices.size(), unused);
+  unsigned int next = 0;
+  for (unsigned int& index : indices) {
+    if (remap[index] == unused) remap[index] = next++;
+    index = remap[index];
+  }
+  for (unsigned int& target : remap) {
+    if (target == unused) target = next++;
+  }
+
+  std::vector<ModelVertex> reordered(vertices.size());
+  for (size_t v = 0; v < vertices.size(); v++) {
+    reordered[remap[v]] = vertices[v];
+  }
+  vertices.swap(reordered);
+}
+
+void optimizeMesh(std::vector<ModelVertex>& vertices,
+                  std::vector<unsigned int>& indices,
+                  const std::vector<MeshLod>& lods, VertexCacheStats& before,
+                  VertexCacheStats& after) {
+  std::vector<MeshLod> ranges = lods;
+  if (ranges.empty()) {
+    ranges.emplace_back();
+    ranges[0].indexCount = static_cast<uint32_t>(indices.size());
+  }
+
+  before = analyzeVertexCache(indices.data() + ranges[0].indexOffset,
+                              ranges[0].indexCount, vertices.size());
+
+  for (const MeshLod& range : ranges) {
+    unsigned int* first = indices.data() + range.indexOffset;
+    optimizeVertexCache(first, range.indexCount, vertices.size());
+    optimizeOverdraw(first, range.indexCount, vertices, kOverdrawThreshold);
+  }
+
+  // Уровень 0 лежит первым, поэтому порядок вершин подстраивается под него
+  optimizeVertexFetch(vertices, indices);
+
+  after = analyzeVertexCache(indices.data() + ranges[0].indexOffset,
+                             ranges[0].indexCount, vertices.size());
+}
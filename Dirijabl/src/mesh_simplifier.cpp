@@ -0,0 +1,279 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Симметричная матрица 4x4 квадрики и суммарный вес граней
+struct Quadric {
+  double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+  double a11 = 0, a12 = 0, a13 = 0;
+  double a22 = 0, a23 = 0;
+  double a33 = 0;
+  double weight = 0;
+
+  // Плоскость n * p + d = 0 с единичной нормалью
+  void addPlane(double nx, double ny, double nz, double d, double w) {
+    a00 += w * nx * nx;
+    a01 += w * nx * ny;
+    a02 += w * nx * nz;
+    a03 += w * nx * d;
+    a11 += w * ny * ny;
+    a12 += w * ny * nz;
+    a13 += w * ny * d;
+    a22 += w * nz * nz;
+    a23 += w * nz * d;
+    a33 += w * d * d;
+    weight += w;
+  }
+
+  void add(const Quadric& q) {
+    a00 += q.a00;
+    a01 += q.a01;
+    a02 += q.a02;
+    a03 += q.a03;
+    a11 += q.a11;
+    a12 += q.a12;
+    a13 += q.a13;
+    a22 += q.a22;
+    a23 += q.a23;
+    a33 += q.a33;
+    weight += q.weight;
+  }
+
+  // Сумма квадратов расстояний до плоскостей, отнесённая к весу
+  double error(const glm::vec3& p) const {
+    const double x = p.x, y = p.y, z = p.z;
+    double e = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z +
+               2 * a03 * x + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y +
+               a22 * z * z + 2 * a23 * z + a33;
+    return weight > 0 ? std::fabs(e) / weight : 0.0;
+  }
+};
+
+struct Collapse {
+  unsigned int from;
+  unsigned int to;
+  double cost;
+};
+
+// Вершины, которые нельзя двигать: лежащие на краю поверхности или на шве,
+// где одна позиция размножена с разными нормалями или UV
+std::vector<bool> findLockedVertices(const std::vector<ModelVertex>& vertices,
+                                     const std::vector<unsigned int>& indices) {
+  std::vector<bool> locked(vertices.size(), false);
+
+  struct PositionHash {
+    size_t operator()(const glm::vec3& p) const {
+      uint32_t bits[3];
+      std::memcpy(bits, &p, sizeof(bits));
+      return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^
+             (bits[2] * 83492791u);
+    }
+  };
+  std::unordered_map<glm::vec3, unsigned int, PositionHash> positions;
+  positions.reserve(vertices.size());
+  for (unsigned int i = 0; i < vertices.size(); i++) {
+    auto inserted = positions.emplace(vertices[i].position, i);
+    if (!inserted.second) {
+      locked[i] = true;
+      locked[inserted.first->second] = true;
+    }
+  }
+
+  // Ребро, которое встречается один раз, — край
+  std::unordered_map<uint64_t, int> edges;
+  edges.reserve(indices.size());
+  for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+    for (int e = 0; e < 3; e++) {
+      uint64_t a = indices[t + e], b = indices[t + (e + 1) % 3];
+      if (a > b) std::swap(a, b);
+      edges[(a << 32) | b]++;
+    }
+  }
+  for (const auto& edge : edges) {
+    if (edge.second == 1) {
+      locked[edge.first >> 32] = true;
+      locked[edge.first & 0xffffffffu] = true;
+    }
+  }
+  return locked;
+}
+
+glm::vec3 triangleNormal(const glm::vec3& a, const glm::vec3& b,
+                         const glm::vec3& c) {
+  return glm::cross(b - a, c - a);
+}
+
+}  // namespace
+
+float simplifyMesh(const std::vector<ModelVertex>& vertices,
+                   const std::vector<unsigned int>& indices,
+                   size_t targetIndexCount, std::vector<unsigned int>& result) {
+  result = indices;
+  if (result.size() <= targetIndexCount || vertices.empty()) return 0.0f;
+
+  const std::vector<bool> locked = findLockedVertices(vertices, indices);
+
+  // Квадрики из плоскостей граней с весом по площади
+  std::vector<Quadric> quadrics(vertices.size());
+  for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+    const glm::vec3& p0 = vertices[indices[t]].position;
+    const glm::vec3& p1 = vertices[indices[t + 1]].position;
+    const glm::vec3& p2 = vertices[indices[t + 2]].position;
+    glm::vec3 n = triangleNormal(p0, p1, p2);
+    float length = glm::length(n);
+    if (length <= 0.0f) continue;
+    n /= length;
+    double d = -glm::dot(n, p0);
+    for (int k = 0; k < 3; k++) {
+      quadrics[indices[t + k]].addPlane(n.x, n.y, n.z, d, length * 0.5);
+    }
+  }
+
+  std::vector<unsigned int> remap(vertices.size());
+  std::vector<unsigned int> adjacencyStart(vertices.size() + 1);
+  std::vector<unsigned int> adjacency;
+  std::vector<bool> touched(vertices.size());
+  std::vector<Collapse> collapses;
+  double maxError = 0.0;
+
+  while (result.size() > targetIndexCount) {
+    const size_t triangles = result.size() / 3;
+
+    // Треугольники при каждой вершине
+    std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+    for (unsigned int v : result) adjacencyStart[v + 1]++;
+    for (size_t v = 0; v < vertices.size(); v++) {
+      adjacencyStart[v + 1] += adjacencyStart[v];
+    }
+    adjacency.resize(result.size());
+    std::vector<unsigned int> fill(adjacencyStart.begin(),
+                                   adjacencyStart.end() - 1);
+    for (size_t i = 0; i < result.size(); i++) {
+      adjacency[fill[result[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    // Кандидаты: каждое ребро в сторону незакреплённой вершины
+    collapses.clear();
+    for (size_t t = 0; t < triangles; t++) {
+      for (int e = 0; e < 3; e++) {
+        unsigned int a = result[t * 3 + e], b = result[t * 3 + (e + 1) % 3];
+        Quadric q = quadrics[a];
+        q.add(quadrics[b]);
+        if (!locked[a]) {
+          collapses.push_back({a, b, q.error(vertices[b].position)});
+        }
+        if (!locked[b]) {
+          collapses.push_back({b, a, q.error(vertices[a].position)});
+        }
+      }
+    }
+    if (collapses.empty()) break;
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse& x, const Collapse& y) {
+                return x.cost < y.cost;
+              });
+
+    // Схлопывание убирает около двух треугольников; за проход каждая
+    // вершина участвует не больше одного раза, чтобы проверки оставались
+    // верными
+    for (size_t v = 0; v < vertices.size(); v++) {
+      remap[v] = static_cast<unsigned int>(v);
+    }
+    std::fill(touched.begin(), touched.end(), false);
+    size_t removed = 0;
+    const size_t needed = triangles - targetIndexCount / 3;
+    for (const Collapse& c : collapses) {
+      if (removed >= needed) break;
+      if (touched[c.from] || touched[c.to]) continue;
+
+      // Грани вокруг from не должны вывернуться
+      const glm::vec3& target = vertices[c.to].position;
+      bool flips = false;
+      size_t lost = 0;
+      for (unsigned int k = adjacencyStart[c.from];
+           k < adjacencyStart[c.from + 1] && !flips; k++) {
+        const unsigned int* tri = &result[adjacency[k] * 3];
+        if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) {
+          lost++;
+          continue;
+        }
+        glm::vec3 p[3], q[3];
+        for (int j = 0; j < 3; j++) {
+          p[j] = vertices[tri[j]].position;
+          q[j] = tri[j] == c.from ? target : p[j];
+        }
+        glm::vec3 before = triangleNormal(p[0], p[1], p[2]);
+        glm::vec3 after = triangleNormal(q[0], q[1], q[2]);
+        if (glm::dot(before, after) <= 0.25f * glm::length(before) *
+                                           glm::length(after)) {
+          flips = true;
+        }
+      }
+      if (flips || lost == 0) continue;
+
+      remap[c.from] = c.to;
+      quadrics[c.to].add(quadrics[c.from]);
+      maxError = std::max(maxError, c.cost);
+      removed += lost;
+
+      for (unsigned int k = adjacencyStart[c.from];
+           k < adjacencyStart[c.from + 1]; k++) {
+        const unsigned int* tri = &result[adjacency[k] * 3];
+        touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = true;
+      }
+    }
+    if (removed == 0) break;
+
+    // Переписать индексы и убрать выродившиеся треугольники
+    size_t write = 0;
+    for (size_t t = 0; t < triangles; t++) {
+      unsigned int a = remap[result[t * 3]];
+      unsigned int b = remap[result[t * 3 + 1]];
+      unsigned int c = remap[result[t * 3 + 2]];
+      if (a == b || b == c || a == c) continue;
+      result[write++] = a;
+      result[write++] = b;
+      result[write++] = c;
+    }
+    result.resize(write);
+  }
+
+  return static_cast<float>(std::sqrt(maxError));
+}
+
+void buildMeshLods(const std::vector<ModelVertex>& vertices,
+                   std::vector<unsigned int>& indices, unsigned int levels,
+                   std::vector<MeshLod>& lods) {
+  lods.clear();
+  MeshLod base;
+  base.indexCount = static_cast<uint32_t>(indices.size());
+  lods.push_back(base);
+
+  std::vector<unsigned int> current = indices;
+  std::vector<unsigned int> simplified;
+  // Каждый уровень строится из предыдущего, поэтому ошибки складываются
+  float error = 0.0f;
+  for (unsigned int level = 1; level < levels; level++) {
+    const size_t target = (current.size() / 2) / 3 * 3;
+    error += simplifyMesh(vertices, current, target, simplified);
+
+    // Меньше чем на четверть — уровень не стоит отдельного рисования
+    if (simplified.empty() || simplified.size() * 4 > current.size() * 3) {
+      break;
+    }
+
+    MeshLod lod;
+    lod.indexOffset = static_cast<uint32_t>(indices.size());
+    lod.indexCount = static_cast<uint32_t>(simplified.size());
+    lod.error = error;
+    lods.push_back(lod);
+
+    indices.insert(indices.end(), simplified.begin(), simplified.end());
+    current.swap(simplified);
+  }
+}
@@ -0,0 +1,105 @@
+#include "mesh_welder.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+inline size_t hashCombine(size_t seed, size_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+inline uint32_t floatBits(float f) {
+  // -0.0 и 0.0 равны по operator==, значит и хэш у них должен совпадать
+  f += 0.0f;
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
+}  // namespace
+
+size_t VertexWelder::TripleHash::operator()(const TripleKey& key) const {
+  size_t h = static_cast<uint32_t>(key.pos);
+  h = hashCombine(h, static_cast<uint32_t>(key.tex));
+  h = hashCombine(h, static_cast<uint32_t>(key.norm));
+  return h;
+}
+
+bool VertexWelder::ValueKey::operator==(const ValueKey& other) const {
+  if (quantized) {
+    return std::memcmp(cells, other.cells, sizeof(cells)) == 0;
+  }
+  return vertex == other.vertex;
+}
+
+size_t VertexWelder::ValueHash::operator()(const ValueKey& key) const {
+  size_t h = 0;
+  if (key.quantized) {
+    for (int32_t cell : key.cells) {
+      h = hashCombine(h, static_cast<uint32_t>(cell));
+    }
+    return h;
+  }
+
+  const ModelVertex& v = key.vertex;
+  const float components[8] = {v.position.x, v.position.y, v.position.z,
+                               v.texCoord.x, v.texCoord.y, v.normal.x,
+                               v.normal.y,   v.normal.z};
+  for (float c : components) {
+    h = hashCombine(h, floatBits(c));
+  }
+  return h;
+}
+
+VertexWelder::VertexWelder(std::vector<ModelVertex>& vertices, float epsilon)
+    : vertices(vertices), epsilon(epsilon > 0.0f ? epsilon : 0.0f) {}
+
+void VertexWelder::reserve(size_t corners) {
+  byTriple.reserve(corners);
+  byValue.reserve(corners);
+  vertices.reserve(vertices.size() + corners);
+}
+
+VertexWelder::ValueKey VertexWelder::makeValueKey(const ModelVertex& v) const {
+  ValueKey key;
+  key.vertex = v;
+  key.quantized = epsilon > 0.0f;
+  if (key.quantized) {
+    const float components[8] = {v.position.x, v.position.y, v.position.z,
+                                 v.texCoord.x, v.texCoord.y, v.normal.x,
+                                 v.normal.y,   v.normal.z};
+    for (int i = 0; i < 8; i++) {
+      key.cells[i] = static_cast<int32_t>(std::lround(components[i] / epsilon));
+    }
+  } else {
+    std::memset(key.cells, 0, sizeof(key.cells));
+  }
+  return key;
+}
+
+unsigned int VertexWelder::add(const ModelVertex& v, int posIdx, int texIdx,
+                               int normIdx) {
+  stats.inputVertices++;
+
+  // Тот же угол уже встречался — значение вершины можно не хэшировать
+  TripleKey triple{posIdx, texIdx, normIdx};
+  auto tripleIt = byTriple.find(triple);
+  if (tripleIt != byTriple.end()) {
+    stats.tripleHits++;
+    return tripleIt->second;
+  }
+
+  // Другие индексы, но та же вершина по значению
+  auto [valueIt, inserted] = byValue.emplace(
+      makeValueKey(v), static_cast<unsigned int>(vertices.size()));
+  if (inserted) {
+    vertices.push_back(v);
+    stats.outputVertices++;
+  } else {
+    stats.valueHits++;
+  }
+
+  byTriple.emplace(triple, valueIt->second);
+  return valueIt->second;
+}
@@ -1,426 +1,606 @@
 #include "model.h"
 
-// Создать и загрузить модель из obj-файла.
-Model::Model(const std::string& filename) {
-  vertices = {};
-  indices = {};
-  VAO = 0, VBO = 0, EBO = 0, instanceVBO = 0;
-  indexCount = 0;
-  load(filename);
-}
-
-// Проверить файл на доступность.
-bool Model::checkFile(const std::string& filename) {
-  std::error_code ec;
-  auto file_status = std::filesystem::status(filename, ec);
-
-  if (ec) {
-    std::cerr << "File check error: " << ec.message() << std::endl;
-    return false;
-  }
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
-  if (!std::filesystem::exists(file_status)) {
-    std::cerr << "File doesn't exist: " << filename << std::endl;
-    return false;
-  }
+#include "shader.h"
 
-  if (std::filesystem::is_directory(file_status)) {
-    std::cerr << "Path is a directory, not a file: " << filename << std::endl;
-    return false;
-  }
+namespace {
 
-  try {
-    auto file_size = std::filesystem::file_size(filename);
-    if (file_size == 0) {
-      std::cerr << "File is empty: " << filename << std::endl;
-      return false;
+// Чистые слоты между изменёнными залить дешевле, чем делать лишний вызов
+constexpr size_t kMaxSlotGap = 4;
+
+// Начальная ёмкость буфера экземпляров
+constexpr size_t kMinInstanceCapacity = 16;
+
+// Запас ограничивающих объёмов на анимацию ветра в вершинном шейдере
+constexpr float kBoundsPadding = 1.1f;
+
+// Самый грубый уровень, ошибка которого на экране не больше допустимой.
+// Ошибки растут с номером уровня.
+size_t selectLod(const std::vector<MeshLod>& lods, const LodView& view,
+                 const glm::vec3& center, float scale) {
+  if (view.pixelsPerUnit <= 0.0f || view.maxPixelError <= 0.0f) return 0;
+
+  const float distance = glm::length(center - view.position);
+  const float pixelsPerError = scale * view.pixelsPerUnit;
+  const size_t count = std::min<size_t>(lods.size(), kMaxLodLevels);
+  size_t selected = 0;
+  for (size_t i = 1; i < count; i++) {
+    if (lods[i].error * pixelsPerError <= view.maxPixelError * distance) {
+      selected = i;
     }
-  } catch (const std::filesystem::filesystem_error& e) {
-    std::cerr << "Couldn't get file size: " << e.what() << std::endl;
   }
-
-  return true;
+  return selected;
 }
 
-// Загрузить модель из obj-файла.
-bool Model::load(const std::string& filename) {
-  std::cout << "Загружаем модель из " << filename << std::endl;
+}  // namespace
 
-  if (!checkFile(filename)) {
-    return createFallbackModel();
-  }
+Model::UploadStats Model::uploadStats;
 
-  std::ifstream file(filename);
-  if (!file.is_open()) {
-    std::cerr << "Не получилось открыть файл: " << filename << std::endl;
-
-    // Проверка доступа к файлу
-    auto perms = std::filesystem::status(filename).permissions();
-    std::string permission_error;
-
-    if ((perms & std::filesystem::perms::owner_read) ==
-            std::filesystem::perms::none &&
-        (perms & std::filesystem::perms::group_read) ==
-            std::filesystem::perms::none &&
-        (perms & std::filesystem::perms::others_read) ==
-            std::filesystem::perms::none) {
-      permission_error = "Нет прав на чтение файла";
-    } else if ((perms & std::filesystem::perms::owner_read) ==
-               std::filesystem::perms::none) {
-      permission_error = "Нет прав пользователя на чтение";
-    }
+// Создать модель из obj-файла.
+Model::Model(const std::string& filename, const ModelLoadOptions& options) {
+  mesh = AssetRegistry::instance().acquireMesh(filename, options);
+}
 
-    if (!permission_error.empty()) {
-      std::cerr << permission_error << std::endl;
-    }
-    return createFallbackModel();
+void Model::loadTexture(const std::string& filename) {
+  if (textureHandle) {
+    std::cerr << "Текстура уже загружена" << std::endl;
+    return;
   }
 
-  if (!file.good()) {
-    std::cerr << "Поток файла в нерабочем состоянии после открытия"
-              << std::endl;
-    return createFallbackModel();
-  }
+  textureHandle = AssetRegistry::instance().acquireTexture(filename);
+  texture = textureHandle->id;
+}
 
-  // Приступаем к чтению данных.
-  std::vector<glm::vec3> positions;
-  std::vector<glm::vec2> texCoords;
-  std::vector<glm::vec3> normals;
-
-  std::string line;
-  while (std::getline(file, line)) {
-    if (line.empty() || line[0] == '#') continue;
-
-    std::istringstream iss(line);
-    std::string type;
-    iss >> type;
-
-    if (type == "v") {
-      float x, y, z;
-      iss >> x >> y >> z;
-      positions.push_back(glm::vec3(x, y, z));
-    } else if (type == "vt") {
-      float u, v;
-      iss >> u >> v;
-      texCoords.push_back(glm::vec2(u, v));
-    } else if (type == "vn") {
-      float x, y, z;
-      iss >> x >> y >> z;
-      normals.push_back(glm::normalize(glm::vec3(x, y, z)));
-    } else if (type == "f") {
-      std::string vertex;
-      std::vector<unsigned int> faceIndices;
-
-      while (iss >> vertex) {
-        unsigned int posIdx = 0, texIdx = 0, normIdx = 0;
-
-        // Парсим "v", "v/vt", "v/vt/vn" или "v//vn"
-        size_t slash1 = vertex.find('/');
-
-        if (slash1 == std::string::npos) {
-          // Только позиция
-          posIdx = std::stoi(vertex);
-        } else {
-          posIdx = std::stoi(vertex.substr(0, slash1));
-          size_t slash2 = vertex.find('/', slash1 + 1);
-
-          if (slash2 != std::string::npos) {
-            if (slash2 >
-                slash1 + 1) {  // true: 1/1/1 # вершины/текстуры/нормали;
-                               // false: 1//1 # вершины//нормали
-              texIdx =
-                  std::stoi(vertex.substr(slash1 + 1, slash2 - (slash1 + 1)));
-            }
-            if (slash2 + 1 < vertex.length()) {
-              normIdx = std::stoi(vertex.substr(slash2 + 1));
-            }
-          } else {  // 1/1 # вершины/текстуры
-            if (slash1 + 1 < vertex.length()) {
-              texIdx = std::stoi(vertex.substr(slash1 + 1));
-            }
-          }
-        }
-
-        ModelVertex v;
-        v.position = positions[posIdx - 1];
-        v.texCoord = texIdx > 0 ? texCoords[texIdx - 1] : glm::vec2(0.0f);
-        v.normal =
-            normIdx > 0 ? normals[normIdx - 1] : glm::vec3(0.0f, 1.0f, 0.0f);
-
-        unsigned int idx = addVertex(v);
-        faceIndices.push_back(idx);
-      }
+ModelInstance Model::createInstance() {
+  return ModelInstance(this, transforms.create());
+}
 
-      // Триангуляция
-      for (size_t i = 1; i < faceIndices.size() - 1; i++) {
-        indices.push_back(faceIndices[0]);
-        indices.push_back(faceIndices[i]);
-        indices.push_back(faceIndices[i + 1]);
-      }
-    }
+void Model::resetFrameUploadStats() {
+  uploadStats.frameBytes = 0;
+  uploadStats.frameRanges = 0;
+}
+
+void Model::setInstanceStreaming(bool enabled) {
+  if (enabled == (instanceStream != nullptr)) return;
+
+  if (enabled) {
+    instanceStream =
+        std::make_unique<InstanceStream>(sizeof(InstanceTransform));
+  } else {
+    instanceStream.reset();
+    // Постоянный буфер мог отстать от экземпляров
+    instanceCapacity = 0;
   }
+}
 
-  file.close();
+void Model::setImpostors(ImpostorRenderer* renderer,
+                         const ImpostorSettings& settings) {
+  impostorRenderer = renderer && renderer->isValid() ? renderer : nullptr;
+  impostorSettings = settings;
+  impostorSettings.views = std::max(impostorSettings.views, 1u);
+  impostorSettings.tileSize = std::max(impostorSettings.tileSize, 1u);
+  // Атлас запечётся заново при следующем рисовании
+  impostorAtlas.reset();
+}
 
-  if (vertices.empty()) {
-    std::cerr << "Модель пуста!" << std::endl;
-    return createFallbackModel();
+void Model::setTextureArray(TextureArray* array) {
+  textureArray = nullptr;
+  textureLayer = -1;
+  if (array && textureHandle) textureLayer = array->addTexture(textureHandle);
+  if (textureLayer >= 0) {
+    textureArray = array;
+    shaderFeatures |= kShaderTextureArray;
+  } else {
+    shaderFeatures &= ~kShaderTextureArray;
+    // Пока модель брала текстуру из массива, своя могла быть выгружена
+    if (textureHandle) AssetRegistry::instance().reloadTexture(textureHandle);
   }
+}
 
-  indexCount = indices.size();
-  setupBuffers();
+void Model::setGpuCulling(GpuCuller* culler) {
+  gpuCuller = culler && culler->isValid() ? culler : nullptr;
+  if (!gpuCuller) gpuCullBuffers.reset();
+}
 
-  std::cout << "Модель загружена: " << vertices.size() << " вершин, "
-            << indexCount << " индексов" << std::endl;
-  return true;
+void Model::drawAllInstances(Shader& shader) const {
+  prepareAllInstances();
+  drawPrepared(shader);
+  glBindVertexArray(0);
 }
 
-void Model::loadTexture(const std::string& filename) {
-  if (texture != 0) {
-    std::cerr << "Текстура уже загружена" << std::endl;
-    return;
+void Model::drawVisibleInstances(Shader& shader, const Frustum& frustum,
+                                 const LodView& lodView) const {
+  prepareVisibleInstances(frustum, lodView);
+  drawPrepared(shader);
+  glBindVertexArray(0);
+}
+
+void Model::prepareAllInstances() const {
+  cullStats = {transforms.size(), 0, 0, 0};
+  prepared.mode = PreparedDraw::Mode::None;
+  if (!mesh->isUploaded() || transforms.size() == 0) return;
+
+  // Обновить буфер экземпляров, если необходимо
+  if (instanceStream) {
+    streamInstances();
+  } else {
+    updateInstanceBuffer();
   }
+  prepared.mode = PreparedDraw::Mode::All;
+}
 
-  if (!checkFile(filename)) {
+void Model::prepareVisibleInstances(const Frustum& frustum,
+                                    const LodView& lodView) const {
+  cullStats = {};
+  prepared.mode = PreparedDraw::Mode::None;
+  prepared.nearestDistance = 0.0f;
+  prepared.lodView = lodView;
+  if (!mesh->isUploaded() || transforms.size() == 0) return;
+
+  const bool impostors = updateImpostors();
+  if (gpuCuller && !instanceStream && !impostors) {
+    prepareGpuCulled(frustum, lodView);
     return;
   }
 
-  sf::Image image;
-  if (image.loadFromFile(filename)) {
-    image.flipVertically();
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
+  transforms.updateMatrices();
+  const size_t visible = cullInstances(frustum, lodView);
+
+  const size_t total = transforms.size();
+  if (lodCounts[0] == total && impostorList.empty()) {
+    // Сжимать нечего: обычный путь с заливкой только изменённых слотов
+    prepareAllInstances();
+    return;
+  }
+  cullStats = {visible, total - visible, 0, impostorList.size()};
+  if (visible == 0) return;
+
+  // Копии для меша и для импосторов; на переходе экземпляр есть в обеих
+  const size_t meshCount = visibleList.size();
+  const size_t impostorCount = impostorList.size();
+  const size_t copies = meshCount + impostorCount;
+
+  InstanceStream* stream = instanceStream.get();
+  if (!stream) {
+    if (!visibleStream) {
+      visibleStream =
+          std::make_unique<InstanceStream>(sizeof(InstanceTransform));
+    }
+    stream = visibleStream.get();
+  }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  // Экземпляры одного уровня лежат в кольце подряд
+  size_t start = 0;
+  for (unsigned int lod = 0; lod < kMaxLodLevels; lod++) {
+    prepared.lodStart[lod] = start;
+    start += lodCounts[lod];
+  }
 
-    sf::Vector2u size = image.getSize();
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size.x, size.y, 0, GL_RGBA,
-                 GL_UNSIGNED_BYTE, image.getPixelsPtr());
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0);
+  // Импосторы идут после всех уровней, доля импостора — в normalScale.w
+  void* ptr = stream->map(copies);
+  if (ptr) {
+    const InstanceTransform* instances = transforms.getInstanceTransforms();
+    InstanceTransform* out = static_cast<InstanceTransform*>(ptr);
+    size_t next[kMaxLodLevels];
+    std::copy(prepared.lodStart, prepared.lodStart + kMaxLodLevels, next);
+    for (size_t i = 0; i < meshCount; i++) {
+      InstanceTransform& copy = out[next[visibleLods[i]]++];
+      copy = instances[visibleList[i]];
+      copy.normalScale.w = visibleFades[i];
+    }
+    for (size_t i = 0; i < impostorCount; i++) {
+      InstanceTransform& copy = out[meshCount + i];
+      copy = instances[impostorList[i]];
+      copy.normalScale.w = impostorFades[i];
+    }
 
-    std::cout << "Текстура загружена: " << filename << std::endl;
-  } else {
-    std::cerr << "Не удалось загрузить текстуру: " << filename << std::endl;
+    const size_t bytes = copies * sizeof(InstanceTransform);
+    uploadStats.frameBytes += bytes;
+    uploadStats.totalBytes += bytes;
+    uploadStats.frameRanges++;
   }
-}
+  prepared.offset = stream->unmap();
+  prepared.stream = stream;
+  prepared.mode = PreparedDraw::Mode::Visible;
 
-ModelInstance* Model::createInstance() {
-  ModelInstance* instance = new ModelInstance(this);
-  instances.push_back(instance);
-  instanceBufferDirty = true;
-  return instance;
+  // В потоковом режиме область пишется целиком, а постоянный буфер
+  // ещё должен получить изменённые слоты, когда отсекать будет нечего
+  if (instanceStream) transforms.clearUploadList();
 }
 
-void Model::drawAllInstances() const {
-  if (VAO == 0 || instances.empty()) return;
+void Model::drawPrepared(Shader& shader) const {
+  if (prepared.mode != PreparedDraw::Mode::None) {
+    // Распаковка позиций общая для всех уровней меша; совпавшее значение
+    // Shader в GL не отправит
+    const PositionDecode& decode = mesh->getPositionDecode();
+    shader.setVec3("positionOffset", decode.offset);
+    shader.setVec3("positionScale", decode.scale);
+
+    // Слой один на все экземпляры и попадает в шейдер значением атрибута
+    if (textureArray) {
+      glVertexAttrib1f(kTextureLayerAttribute,
+                       static_cast<float>(textureLayer));
+    }
+  }
 
-  // Обновить буфер экземпляров, если необходимо
-  updateInstanceBuffer();
+  switch (prepared.mode) {
+    case PreparedDraw::Mode::None:
+      break;
+
+    case PreparedDraw::Mode::All:
+      drawInstanced(0, transforms.size(), prepared.buffer, prepared.offset);
+      if (instanceStream) instanceStream->fence();
+      break;
+
+    case PreparedDraw::Mode::Visible: {
+      InstanceStream* stream = prepared.stream;
+      for (unsigned int lod = 0; lod < kMaxLodLevels; lod++) {
+        if (lodCounts[lod] == 0) continue;
+        drawInstanced(lod, lodCounts[lod], stream->getBuffer(),
+                      prepared.offset +
+                          prepared.lodStart[lod] * sizeof(InstanceTransform));
+      }
+      const size_t impostorCount = impostorList.size();
+      if (impostorCount > 0) {
+        impostorRenderer->draw(
+            *impostorAtlas, stream->getBuffer(),
+            prepared.offset + visibleList.size() * sizeof(InstanceTransform),
+            impostorCount, prepared.lodView);
+        cullStats.triangles += 2 * impostorCount;
+        cullStats.drawCalls++;
+      }
+      stream->fence();
+      break;
+    }
 
-  glBindVertexArray(VAO);
-  glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0,
-                          instances.size());
-  glBindVertexArray(0);
+    case PreparedDraw::Mode::GpuCulled:
+      for (unsigned int lod = 0; lod < kMaxLodLevels; lod++) {
+        if (prepared.gpuCounts[lod] == 0) continue;
+        drawInstanced(lod, prepared.gpuCounts[lod], prepared.gpuBuffers[lod],
+                      0);
+      }
+      break;
+  }
+  prepared.mode = PreparedDraw::Mode::None;
 }
 
-void Model::updateInstanceBuffer() const {
-  if (!instanceBufferDirty) return;
+bool Model::updateImpostors() const {
+  if (!impostorRenderer) return false;
+  if (impostorAtlas) return impostorAtlas->isBaked();
+
+  // Запекать только окончательную геометрию и текстуру. Заполненный
+  // массив выгружает исходную текстуру, поэтому тогда текстура берётся
+  // из слоя
+  if (!mesh->isReady()) return false;
+  if (textureArray) {
+    if (!textureArray->isComplete()) return false;
+  } else if (textureHandle) {
+    Texture::Status status = textureHandle->getStatus();
+    if (status != Texture::Status::Ready &&
+        status != Texture::Status::Failed) {
+      return false;
+    }
+  }
 
-  // Сбор всех матриц преобразований
-  instanceMatrices.clear();
-  for (const auto& instance : instances) {
-    instanceMatrices.push_back(instance->getTransform());
+  impostorAtlas = std::make_unique<ImpostorAtlas>(impostorSettings);
+  if (!impostorRenderer->bake(*impostorAtlas, *mesh, getTextureTarget(),
+                              getDrawTexture(), std::max(textureLayer, 0))) {
+    std::cerr << "Не получилось запечь импосторы" << std::endl;
+    return false;
   }
+  return true;
+}
 
-  if (instanceMatrices.empty()) return;
+void Model::prepareGpuCulled(const Frustum& frustum,
+                             const LodView& lodView) const {
+  // Постоянный буфер получает только изменённые слоты, а у неподвижных
+  // экземпляров их нет
+  updateInstanceBuffer();
 
-  if (instanceVBO == 0) {
-    glGenBuffers(1, &instanceVBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-
-    // 4 вектора vec4 в качестве mat4
-    for (int i = 0; i < 4; i++) {
-      glEnableVertexAttribArray(3 + i);
-      glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
-                            (void*)(i * sizeof(glm::vec4)));
-      glVertexAttribDivisor(3 + i, 1);  // Задать обход буфера экземпляров
-    }
+  if (!gpuCullBuffers) gpuCullBuffers = std::make_unique<GpuCullBuffers>();
+  gpuCullBuffers->prepare(instanceVBO, instanceCapacity);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+  const size_t total = transforms.size();
+  const Bounds bounds = getCullBounds();
+  if (instanceBoundsDirty || instanceBoundsCount != total ||
+      instanceBoundsSource.center != bounds.center ||
+      instanceBoundsSource.radius != bounds.radius) {
+    updateInstanceBounds(bounds);
   }
 
-  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-  glBufferData(GL_ARRAY_BUFFER, instanceMatrices.size() * sizeof(glm::mat4),
-               instanceMatrices.data(), GL_DYNAMIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  // Расстояний до видимых GPU не возвращает, поэтому глубина модели —
+  // расстояние от камеры до объёма всех её экземпляров
+  const glm::vec3 closest =
+      glm::clamp(lodView.position, instanceBounds.min, instanceBounds.max);
+  prepared.nearestDistance = glm::length(lodView.position - closest);
+
+  GpuCuller::Result result =
+      gpuCuller->cull(*gpuCullBuffers, frustum, lodView, bounds,
+                      mesh->getLods(), total);
+
+  size_t visible = 0;
+  for (unsigned int lod = 0; lod < kMaxLodLevels; lod++) {
+    const size_t count = std::min(result.visible[lod], total - visible);
+    visible += count;
+    prepared.gpuBuffers[lod] = result.buffers[lod];
+    prepared.gpuCounts[lod] = count;
+  }
+  prepared.mode = PreparedDraw::Mode::GpuCulled;
+  cullStats.visible = visible;
+  cullStats.culled = total - visible;
+}
 
-  instanceBufferDirty = false;
+Bounds Model::getCullBounds() const {
+  // Объёмы с запасом на смещение вершин анимацией
+  Bounds bounds = mesh->getBounds();
+  glm::vec3 halfExtent = (bounds.max - bounds.min) * (0.5f * kBoundsPadding);
+  bounds.min = bounds.center - halfExtent;
+  bounds.max = bounds.center + halfExtent;
+  bounds.radius *= kBoundsPadding;
+  return bounds;
 }
 
-void Model::setupBuffers() {
-  if (VAO == 0) {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+void Model::updateInstanceBounds(const Bounds& bounds) const {
+  const InstanceTransform* instances = transforms.getInstanceTransforms();
+  const size_t count = transforms.size();
+  glm::vec3 min(std::numeric_limits<float>::max());
+  glm::vec3 max(-std::numeric_limits<float>::max());
+  for (size_t dense = 0; dense < count; dense++) {
+    const InstanceTransform& instance = instances[dense];
+    glm::vec3 center =
+        glm::vec3(instance.model * glm::vec4(bounds.center, 1.0f));
+    const glm::vec4& ns = instance.normalScale;
+    float scale = 1.0f / std::sqrt(std::min(ns.x, std::min(ns.y, ns.z)));
+    glm::vec3 extent(bounds.radius * scale);
+    min = glm::min(min, center - extent);
+    max = glm::max(max, center + extent);
   }
+  if (count == 0) min = max = glm::vec3(0.0f);
+
+  instanceBounds.min = min;
+  instanceBounds.max = max;
+  instanceBounds.center = (min + max) * 0.5f;
+  instanceBounds.radius = glm::length(max - min) * 0.5f;
+  instanceBoundsSource = bounds;
+  instanceBoundsCount = count;
+  instanceBoundsDirty = false;
+}
+
+size_t Model::cullInstances(const Frustum& frustum,
+                            const LodView& lodView) const {
+  visibleList.clear();
+  visibleLods.clear();
+  visibleFades.clear();
+  impostorList.clear();
+  impostorFades.clear();
+  std::fill(lodCounts, lodCounts + kMaxLodLevels, 0);
+
+  const Bounds bounds = getCullBounds();
+  const std::vector<MeshLod>& lods = mesh->getLods();
+
+  // Без камеры (pixelsPerUnit == 0) рисуется только меш
+  const bool impostors = impostorAtlas && impostorAtlas->isBaked() &&
+                         lodView.pixelsPerUnit > 0.0f;
+  const float fadeStart = impostorSettings.distance;
+  const float fadeRange = std::max(impostorSettings.fadeRange, 1e-3f);
+  size_t visible = 0;
+  float nearest = std::numeric_limits<float>::max();
+
+  const InstanceTransform* instances = transforms.getInstanceTransforms();
+  const uint32_t count = static_cast<uint32_t>(transforms.size());
+  for (uint32_t dense = 0; dense < count; dense++) {
+    const InstanceTransform& instance = instances[dense];
+    glm::vec3 center =
+        glm::vec3(instance.model * glm::vec4(bounds.center, 1.0f));
+
+    // Наибольший масштаб берётся из множителя нормалей 1 / scale^2
+    const glm::vec4& ns = instance.normalScale;
+    float scale = 1.0f / std::sqrt(std::min(ns.x, std::min(ns.y, ns.z)));
+    float radius = bounds.radius * scale;
+
+    // Сфера отсекает дёшево; пограничные экземпляры проверяются по AABB
+    Frustum::Result result = frustum.testSphere(center, radius);
+    if (result == Frustum::Result::Outside) continue;
+    if (result == Frustum::Result::Intersects &&
+        !frustum.intersectsBox(bounds, instance.model)) {
+      continue;
+    }
+    visible++;
 
-  glBindVertexArray(VAO);
+    // Глубина модели для очереди — расстояние до ближайшего экземпляра
+    const float distance = glm::length(center - lodView.position);
+    nearest = std::min(nearest, distance);
 
-  // Вершины
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(ModelVertex),
-               vertices.data(), GL_STATIC_DRAW);
+    // Доля импостора: 0 до начала перехода, 1 после него
+    float fade = 0.0f;
+    if (impostors) {
+      fade = std::clamp((distance - fadeStart) / fadeRange, 0.0f, 1.0f);
+    }
+    if (fade > 0.0f) {
+      impostorList.push_back(dense);
+      impostorFades.push_back(fade);
+      if (fade >= 1.0f) continue;
+    }
 
-  // Полигоны через индексы
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
-               indices.data(), GL_STATIC_DRAW);
+    size_t lod = selectLod(lods, lodView, center, scale);
+    visibleList.push_back(dense);
+    visibleLods.push_back(static_cast<uint8_t>(lod));
+    visibleFades.push_back(fade);
+    lodCounts[lod]++;
+  }
+  prepared.nearestDistance = visible > 0 ? nearest : 0.0f;
+  return visible;
+}
 
-  // Позиции вершин
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ModelVertex),
-                        (void*)offsetof(ModelVertex, position));
-  glEnableVertexAttribArray(0);
+void Model::drawInstanced(size_t lod, size_t count, GLuint buffer,
+                          size_t offset) const {
+  const std::vector<MeshLod>& lods = mesh->getLods();
+  if (lod >= lods.size()) return;
+
+  // Уровни делят вершины, а индексы лежат в арене друг за другом, начиная
+  // с первого индекса меша. VAO арены остаётся привязанным: следующая
+  // модель того же формата сменит в нём только атрибуты экземпляров.
+  const MeshLod& range = lods[lod];
+  GeometryArena::instance().bind(mesh->getArenaHandle(), buffer, offset);
+  glDrawElementsInstancedBaseVertex(
+      GL_TRIANGLES, range.indexCount, mesh->getIndexType(),
+      (void*)((mesh->getFirstIndex() + range.indexOffset) *
+              mesh->getIndexSize()),
+      count, mesh->getBaseVertex());
+  cullStats.triangles += range.indexCount / 3 * count;
+  cullStats.drawCalls++;
+}
 
-  // Текстурные координаты
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ModelVertex),
-                        (void*)offsetof(ModelVertex, texCoord));
-  glEnableVertexAttribArray(1);
+void Model::streamInstances() const {
+  transforms.updateMatrices();
+
+  const size_t count = transforms.size();
+  void* ptr = instanceStream->map(count);
+  if (ptr) {
+    const size_t bytes = count * sizeof(InstanceTransform);
+    std::memcpy(ptr, transforms.getInstanceTransforms(), bytes);
+    uploadStats.frameBytes += bytes;
+    uploadStats.totalBytes += bytes;
+    uploadStats.frameRanges++;
+  }
+  size_t offset = instanceStream->unmap();
 
-  // Нормали
-  glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(ModelVertex),
-                        (void*)offsetof(ModelVertex, normal));
-  glEnableVertexAttribArray(2);
+  // Каждая область кольца пишется целиком, отметки слотов не нужны
+  transforms.clearUploadList();
 
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  // Атрибуты читают область текущего кадра
+  prepared.buffer = instanceStream->getBuffer();
+  prepared.offset = offset;
 }
 
-Model::~Model() {
-  for (auto instance : instances) {
-    delete instance;
+void Model::updateInstanceBuffer() const {
+  transforms.updateMatrices();
+
+  std::vector<uint32_t>& dirtySlots = transforms.getUploadList();
+  const size_t count = transforms.size();
+  if (dirtySlots.empty() && count <= instanceCapacity) {
+    prepared.buffer = instanceVBO;
+    prepared.offset = 0;
+    return;
   }
-  instances.clear();
+  instanceBoundsDirty = true;
 
-  if (EBO != 0) glDeleteBuffers(1, &EBO);
-  if (VBO != 0) glDeleteBuffers(1, &VBO);
-  if (instanceVBO != 0) glDeleteBuffers(1, &instanceVBO);
-  if (VAO != 0) glDeleteVertexArrays(1, &VAO);
-  if (texture != 0) glDeleteTextures(1, &texture);
-  vertices.clear();
-  indices.clear();
-}
+  if (instanceVBO == 0) {
+    glGenBuffers(1, &instanceVBO);
+  }
+  prepared.buffer = instanceVBO;
+  prepared.offset = 0;
+
+  glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+
+  const InstanceTransform* instances = transforms.getInstanceTransforms();
+  if (count > instanceCapacity) {
+    // Ёмкость удваивается, и буфер переопределяется лишь при росте
+    size_t capacity = std::max(instanceCapacity, kMinInstanceCapacity);
+    while (capacity < count) capacity *= 2;
+    instanceCapacity = capacity;
+
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(InstanceTransform),
+                 nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(InstanceTransform),
+                    instances);
+    uploadStats.frameBytes += count * sizeof(InstanceTransform);
+    uploadStats.totalBytes += count * sizeof(InstanceTransform);
+    uploadStats.frameRanges++;
+  } else {
+    // Изменённые слоты сливаются в непрерывные диапазоны
+    std::sort(dirtySlots.begin(), dirtySlots.end());
+    size_t i = 0;
+    while (i < dirtySlots.size() && dirtySlots[i] < count) {
+      size_t first = dirtySlots[i];
+      size_t end = first + 1;
+      i++;
+      while (i < dirtySlots.size() && dirtySlots[i] < count &&
+             dirtySlots[i] <= end + kMaxSlotGap) {
+        end = dirtySlots[i] + 1;
+        i++;
+      }
 
-unsigned int Model::addVertex(const ModelVertex& v) {
-  for (size_t i = 0; i < vertices.size(); i++) {
-    if (vertices[i] == v) {
-      return i;
+      const size_t bytes = (end - first) * sizeof(InstanceTransform);
+      glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(InstanceTransform),
+                      bytes, instances + first);
+      uploadStats.frameBytes += bytes;
+      uploadStats.totalBytes += bytes;
+      uploadStats.frameRanges++;
     }
   }
-  vertices.push_back(v);
-  return vertices.size() - 1;
-}
-
-bool Model::createFallbackModel() {
-  std::cout << "Создан куб вместо модели" << std::endl;
-
-  vertices = {
-      // Front
-      {{-0.5f, -0.5f, 0.5f}, {0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
-      {{0.5f, -0.5f, 0.5f}, {1.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
-      {{0.5f, 0.5f, 0.5f}, {1.0f, 1.0f}, {0.0f, 0.0f, 1.0f}},
-      {{-0.5f, 0.5f, 0.5f}, {0.0f, 1.0f}, {0.0f, 0.0f, 1.0f}},
-      // Back
-      {{-0.5f, -0.5f, -0.5f}, {1.0f, 0.0f}, {0.0f, 0.0f, -1.0f}},
-      {{0.5f, -0.5f, -0.5f}, {0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}},
-      {{0.5f, 0.5f, -0.5f}, {0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}},
-      {{-0.5f, 0.5f, -0.5f}, {1.0f, 1.0f}, {0.0f, 0.0f, -1.0f}},
-  };
-
-  indices = {
-      0, 1, 2, 0, 2, 3,  // Front
-      4, 6, 5, 4, 7, 6,  // Back
-      0, 4, 5, 0, 5, 1,  // Bottom
-      2, 6, 7, 2, 7, 3,  // Top
-      0, 3, 7, 0, 7, 4,  // Left
-      1, 5, 6, 1, 6, 2,  // Right
-  };
-
-  indexCount = indices.size();
-  setupBuffers();
 
-  return true;
-}
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-// ModelInstance
+  transforms.clearUploadList();
+}
 
-ModelInstance::ModelInstance(Model* parentModel) : parentModel(parentModel) {
-  updateTransform();
+Model::~Model() {
+  // Меш и текстура освобождаются реестром, когда их отпустит последняя модель
+  if (instanceVBO != 0) glDeleteBuffers(1, &instanceVBO);
 }
 
-ModelInstance::~ModelInstance() {
-  // Надо удалить этот экзмепляр из родительской модели
+// ModelInstance
+
+void ModelInstance::destroy() {
   if (parentModel) {
-    auto& instances =
-        const_cast<std::vector<ModelInstance*>&>(parentModel->getInstances());
-    instances.erase(std::remove(instances.begin(), instances.end(), this),
-                    instances.end());
-    parentModel->instanceBufferDirty = true;
+    parentModel->transforms.remove(handle);
   }
 }
 
 void ModelInstance::setPosition(const glm::vec3& position) {
-  this->position = position;
-  updateTransform();
-  markInstanceBufferDirty();
+  if (parentModel) parentModel->transforms.setPosition(handle, position);
 }
 
 void ModelInstance::setRotation(const glm::vec3& axis, float angleDegrees) {
-  this->rotationAxis = glm::normalize(axis);
-  this->rotationAngle = angleDegrees;
-  updateTransform();
-  markInstanceBufferDirty();
+  if (parentModel) {
+    parentModel->transforms.setRotation(handle, axis, angleDegrees);
+  }
 }
 
 void ModelInstance::setScale(const glm::vec3& scale) {
-  this->scale = scale;
-  updateTransform();
-  markInstanceBufferDirty();
+  if (parentModel) parentModel->transforms.setScale(handle, scale);
 }
 
 void ModelInstance::translate(const glm::vec3& translation) {
-  position += translation;
-  updateTransform();
-  markInstanceBufferDirty();
+  if (parentModel) parentModel->transforms.translate(handle, translation);
 }
 
 void ModelInstance::rotate(const glm::vec3& axis, float angleDegrees) {
-  rotationAxis = glm::normalize(axis);
-  rotationAngle += angleDegrees;
-  updateTransform();
-  markInstanceBufferDirty();
+  if (parentModel) {
+    parentModel->transforms.rotate(handle, axis, angleDegrees);
+  }
 }
 
 void ModelInstance::scaleBy(const glm::vec3& scaling) {
-  scale *= scaling;
-  updateTransform();
-  markInstanceBufferDirty();
+  if (parentModel) parentModel->transforms.scaleBy(handle, scaling);
 }
 
-void ModelInstance::updateTransform() {
-  transform = glm::mat4(1.0f);
-  transform = glm::translate(transform, position);
-  transform = glm::rotate(transform, glm::radians(rotationAngle), rotationAxis);
-  transform = glm::scale(transform, scale);
+glm::mat4 ModelInstance::getTransform() const {
+  return parentModel ? parentModel->transforms.getMatrix(handle)
+                     : glm::mat4(1.0f);
 }
 
-void ModelInstance::markInstanceBufferDirty() {
-  if (parentModel) {
-    parentModel->instanceBufferDirty = true;
-  }
-}
\ No newline at end of file
+glm::vec3 ModelInstance::getPosition() const {
+  return parentModel ? parentModel->transforms.getPosition(handle)
+                     : glm::vec3(0.0f);
+}
+
+glm::vec3 ModelInstance::getScale() const {
+  return parentModel ? parentModel->transforms.getScale(handle)
+                     : glm::vec3(1.0f);
+}
+
+float ModelInstance::getRotationAngle() const {
+  return parentModel ? parentModel->transforms.getRotationAngle(handle)
+                     : 0.0f;
+}
+
+glm::vec3 ModelInstance::getRotationAxis() const {
+  return parentModel ? parentModel->transforms.getRotationAxis(handle)
+                     : glm::vec3(0.0f, 1.0f, 0.0f);
+}
@@ -0,0 +1,355 @@
+#include "obj_parser.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#include "thread_pool.h"
+
+namespace {
+
+// Куски меньше этого размера не стоит разбирать в отдельных потоках
+constexpr size_t kMinChunkSize = 256 * 1024;
+
+// Отрицательный индекс, найденный в куске файла. Число элементов до начала
+// куска заранее неизвестно, поэтому индекс досчитывается при слиянии.
+struct RelativeIndex {
+  size_t corner;   // Номер угла в куске
+  int component;   // 0 — позиция, 1 — текстура, 2 — нормаль
+  int local;       // Индекс относительно начала куска, может быть < 0
+};
+
+inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline const char* skipSpaces(const char* p, const char* end) {
+  while (p < end && isSpace(*p)) ++p;
+  return p;
+}
+
+// Прочитать число с плавающей точкой; при неудаче p не меняется
+inline bool scanFloat(const char*& p, const char* end, float& value) {
+  const char* s = skipSpaces(p, end);
+  if (s < end && *s == '+') ++s;
+  auto result = std::from_chars(s, end, value);
+  if (result.ec != std::errc()) return false;
+  p = result.ptr;
+  return true;
+}
+
+// Прочитать до count чисел подряд; недостающие остаются без изменений
+inline void scanFloats(const char*& p, const char* end, float* values,
+                       int count) {
+  for (int i = 0; i < count && scanFloat(p, end, values[i]); i++) {
+  }
+}
+
+// Прочитать целое со знаком без пробелов перед ним
+inline bool scanInt(const char*& p, const char* end, int& value) {
+  const char* s = p;
+  bool negative = false;
+  if (s < end && (*s == '-' || *s == '+')) {
+    negative = *s == '-';
+    ++s;
+  }
+  if (s == end || *s < '0' || *s > '9') return false;
+
+  int result = 0;
+  while (s < end && *s >= '0' && *s <= '9') {
+    result = result * 10 + (*s - '0');
+    ++s;
+  }
+  value = negative ? -result : result;
+  p = s;
+  return true;
+}
+
+// Индекс OBJ (с единицы или отрицательный) -> индекс с нуля.
+// Отрицательный индекс отсчитывается от числа уже прочитанных элементов.
+// Индекс, ушедший до начала массива, помечается как -2.
+inline int resolveIndex(int raw, size_t count) {
+  if (raw > 0) return raw - 1;
+  int index = static_cast<int>(count) + raw;
+  return index >= 0 ? index : -2;
+}
+
+// Разобрать индекс одной компоненты угла. Если задан deferred, отрицательные
+// индексы не разрешаются сразу, а откладываются до слияния кусков.
+inline bool scanIndex(const char*& p, const char* end, size_t count,
+                      int component, const ObjData& out,
+                      std::vector<RelativeIndex>* deferred, int& index) {
+  int raw = 0;
+  if (!scanInt(p, end, raw) || raw == 0) return false;
+
+  if (raw < 0 && deferred) {
+    deferred->push_back({out.corners.size(), component,
+                         static_cast<int>(count) + raw});
+    index = -1;
+  } else {
+    index = resolveIndex(raw, count);
+  }
+  return true;
+}
+
+// Прочитать угол грани в одной из форм v, v/vt, v/vt/vn, v//vn
+inline bool scanCorner(const char*& p, const char* end, const ObjData& out,
+                       std::vector<RelativeIndex>* deferred,
+                       ObjCorner& corner) {
+  corner = {-1, -1, -1};
+
+  if (!scanIndex(p, end, out.positions.size(), 0, out, deferred,
+                 corner.pos)) {
+    return false;
+  }
+
+  if (p < end && *p == '/') {
+    ++p;
+    if (p < end && *p != '/') {
+      if (!scanIndex(p, end, out.texCoords.size(), 1, out, deferred,
+                     corner.tex)) {
+        return false;
+      }
+    }
+    if (p < end && *p == '/') {
+      ++p;
+      if (!scanIndex(p, end, out.normals.size(), 2, out, deferred,
+                     corner.norm)) {
+        return false;
+      }
+    }
+  }
+
+  return p == end || isSpace(*p) || *p == '#';
+}
+
+// Разобрать диапазон строк. При ошибке errorLine — номер строки в диапазоне.
+bool parseRange(const char* begin, const char* end, ObjData& out,
+                std::vector<RelativeIndex>* deferred, size_t& errorLine) {
+  size_t lineNumber = 0;
+  const char* p = begin;
+
+  while (p < end) {
+    const char* lineEnd =
+        static_cast<const char*>(std::memchr(p, '\n', end - p));
+    if (!lineEnd) lineEnd = end;
+    lineNumber++;
+
+    const char* s = skipSpaces(p, lineEnd);
+    p = lineEnd + 1;
+
+    if (s == lineEnd || *s == '#') continue;
+
+    // Тип записи — один или два символа, за которыми идёт пробел
+    char type0 = *s;
+    char type1 = (s + 1 < lineEnd) ? s[1] : '\0';
+
+    if (type0 == 'v' && isSpace(type1)) {
+      float xyz[3] = {0.0f, 0.0f, 0.0f};
+      s += 1;
+      scanFloats(s, lineEnd, xyz, 3);
+      out.positions.emplace_back(xyz[0], xyz[1], xyz[2]);
+    } else if (type0 == 'v' && type1 == 't' && s + 2 < lineEnd &&
+               isSpace(s[2])) {
+      float uv[2] = {0.0f, 0.0f};
+      s += 2;
+      scanFloats(s, lineEnd, uv, 2);
+      out.texCoords.emplace_back(uv[0], uv[1]);
+    } else if (type0 == 'v' && type1 == 'n' && s + 2 < lineEnd &&
+               isSpace(s[2])) {
+      float xyz[3] = {0.0f, 0.0f, 0.0f};
+      s += 2;
+      scanFloats(s, lineEnd, xyz, 3);
+      out.normals.push_back(
+          glm::normalize(glm::vec3(xyz[0], xyz[1], xyz[2])));
+    } else if (type0 == 'f' && isSpace(type1)) {
+      s += 1;
+      uint32_t faceSize = 0;
+      while (true) {
+        s = skipSpaces(s, lineEnd);
+        if (s == lineEnd || *s == '#') break;
+
+        ObjCorner corner;
+        if (!scanCorner(s, lineEnd, out, deferred, corner)) {
+          errorLine = lineNumber;
+          return false;
+        }
+        out.corners.push_back(corner);
+        faceSize++;
+      }
+      out.faceSizes.push_back(faceSize);
+    }
+  }
+
+  return true;
+}
+
+std::string faceError(size_t lineNumber) {
+  return "Некорректная грань в строке " + std::to_string(lineNumber);
+}
+
+}  // namespace
+
+void ObjData::clear() {
+  positions.clear();
+  texCoords.clear();
+  normals.clear();
+  corners.clear();
+  faceSizes.clear();
+}
+
+bool parseObj(const char* begin, const char* end, ObjData& out,
+              std::string& error) {
+  size_t errorLine = 0;
+  if (!parseRange(begin, end, out, nullptr, errorLine)) {
+    error = faceError(errorLine);
+    return false;
+  }
+  return true;
+}
+
+bool parseObjParallel(const char* begin, const char* end, ObjData& out,
+                      std::string& error, ThreadPool& pool,
+                      unsigned int chunks) {
+  const size_t size = static_cast<size_t>(end - begin);
+  if (chunks == 0) chunks = pool.getThreadCount();
+  chunks = static_cast<unsigned int>(
+      std::min<size_t>(chunks, std::max<size_t>(1, size / kMinChunkSize)));
+  if (chunks <= 1) {
+    return parseObj(begin, end, out, error);
+  }
+
+  // 1. Нарезка файла на куски по границам строк
+  std::vector<const char*> bounds(chunks + 1, end);
+  bounds[0] = begin;
+  for (unsigned int i = 1; i < chunks; i++) {
+    const char* p = std::max(bounds[i - 1], begin + size * i / chunks);
+    const char* newline =
+        static_cast<const char*>(std::memchr(p, '\n', end - p));
+    bounds[i] = newline ? newline + 1 : end;
+  }
+
+  // 2. Разбор кусков на пуле потоков
+  struct Chunk {
+    ObjData data;
+    std::vector<RelativeIndex> deferred;
+    size_t errorLine = 0;
+    bool ok = true;
+  };
+  std::vector<Chunk> parts(chunks);
+  std::vector<std::future<void>> pending;
+  pending.reserve(chunks);
+
+  for (unsigned int i = 0; i < chunks; i++) {
+    pending.push_back(pool.submit([&parts, &bounds, i]() {
+      Chunk& part = parts[i];
+      part.ok = parseRange(bounds[i], bounds[i + 1], part.data,
+                           &part.deferred, part.errorLine);
+    }));
+  }
+  for (auto& future : pending) {
+    pool.wait(future);
+  }
+
+  for (unsigned int i = 0; i < chunks; i++) {
+    if (!parts[i].ok) {
+      // Номер строки в куске переводится в номер строки в файле
+      size_t linesBefore = std::count(begin, bounds[i], '\n');
+      error = faceError(linesBefore + parts[i].errorLine);
+      return false;
+    }
+  }
+
+  // 3. Слияние. Положительные индексы уже глобальные, а отрицательные
+  // досчитываются от числа элементов во всех предыдущих кусках.
+  size_t totals[5] = {out.positions.size(), out.texCoords.size(),
+                      out.normals.size(), out.corners.size(),
+                      out.faceSizes.size()};
+  for (const Chunk& part : parts) {
+    totals[0] += part.data.positions.size();
+    totals[1] += part.data.texCoords.size();
+    totals[2] += part.data.normals.size();
+    totals[3] += part.data.corners.size();
+    totals[4] += part.data.faceSizes.size();
+  }
+  out.positions.reserve(totals[0]);
+  out.texCoords.reserve(totals[1]);
+  out.normals.reserve(totals[2]);
+  out.corners.reserve(totals[3]);
+  out.faceSizes.reserve(totals[4]);
+
+  for (Chunk& part : parts) {
+    const size_t base[3] = {out.positions.size(), out.texCoords.size(),
+                            out.normals.size()};
+    const size_t cornerBase = out.corners.size();
+
+    out.positions.insert(out.positions.end(), part.data.positions.begin(),
+                         part.data.positions.end());
+    out.texCoords.insert(out.texCoords.end(), part.data.texCoords.begin(),
+                         part.data.texCoords.end());
+    out.normals.insert(out.normals.end(), part.data.normals.begin(),
+                       part.data.normals.end());
+    out.corners.insert(out.corners.end(), part.data.corners.begin(),
+                       part.data.corners.end());
+    out.faceSizes.insert(out.faceSizes.end(), part.data.faceSizes.begin(),
+                         part.data.faceSizes.end());
+
+    for (const RelativeIndex& rel : part.deferred) {
+      ObjCorner& corner = out.corners[cornerBase + rel.corner];
+      int index = static_cast<int>(base[rel.component]) + rel.local;
+      int& target = rel.component == 0   ? corner.pos
+                    : rel.component == 1 ? corner.tex
+                                         : corner.norm;
+      target = index >= 0 ? index : -2;
+    }
+  }
+
+  return true;
+}
+
+bool buildObjMesh(const ObjData& obj, float weldEpsilon,
+                  std::vector<ModelVertex>& vertices,
+                  std::vector<unsigned int>& indices, WeldStats& stats,
+                  std::string& error) {
+  VertexWelder welder(vertices, weldEpsilon);
+  welder.reserve(obj.corners.size());
+
+  const int positionCount = static_cast<int>(obj.positions.size());
+  const int texCoordCount = static_cast<int>(obj.texCoords.size());
+  const int normalCount = static_cast<int>(obj.normals.size());
+
+  // Индексы одной грани; буфер переиспользуется между гранями
+  std::vector<unsigned int> faceIndices;
+
+  size_t cornerIdx = 0;
+  for (size_t face = 0; face < obj.faceSizes.size(); face++) {
+    const uint32_t faceSize = obj.faceSizes[face];
+    faceIndices.clear();
+
+    for (uint32_t i = 0; i < faceSize; i++, cornerIdx++) {
+      const ObjCorner& c = obj.corners[cornerIdx];
+      if (c.pos < 0 || c.pos >= positionCount || c.tex >= texCoordCount ||
+          c.norm >= normalCount || c.tex < -1 || c.norm < -1) {
+        error = "Индекс вершины за пределами массива в грани " +
+                std::to_string(face + 1);
+        return false;
+      }
+
+      ModelVertex v;
+      v.position = obj.positions[c.pos];
+      v.texCoord = c.tex >= 0 ? obj.texCoords[c.tex] : glm::vec2(0.0f);
+      v.normal =
+          c.norm >= 0 ? obj.normals[c.norm] : glm::vec3(0.0f, 1.0f, 0.0f);
+
+      faceIndices.push_back(welder.add(v, c.pos, c.tex, c.norm));
+    }
+
+    // Триангуляция
+    for (size_t i = 1; i + 1 < faceIndices.size(); i++) {
+      indices.push_back(faceIndices[0]);
+      indices.push_back(faceIndices[i]);
+      indices.push_back(faceIndices[i + 1]);
+    }
+  }
+
+  stats = welder.getStats();
+  return true;
+}
@@ -0,0 +1,258 @@
+#include "program_cache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+#include "mapped_file.h"
+
+namespace {
+
+constexpr char kMagic[4] = {'D', 'P', 'R', 'G'};
+constexpr const char* kCacheDirectory = "shader_cache";
+
+uint64_t hashString(const char* text, uint64_t seed) {
+  if (!text) text = "";
+  // Длина разделяет соседние строки: "ab" + "c" и "a" + "bc" различаются
+  const uint64_t length = std::strlen(text);
+  seed = hashBytes(&length, sizeof(length), seed);
+  return hashBytes(text, length, seed);
+}
+
+const char* stageName(GLenum type) {
+  switch (type) {
+    case GL_VERTEX_SHADER:
+      return "VERTEX";
+    case GL_GEOMETRY_SHADER:
+      return "GEOMETRY";
+    case GL_FRAGMENT_SHADER:
+      return "FRAGMENT";
+  }
+  return "?";
+}
+
+GLuint compileStage(const std::string& name,
+                    const ProgramCache::Stage& stage) {
+  GLuint shader = glCreateShader(stage.type);
+  glShaderSource(shader, static_cast<GLsizei>(stage.sources.size()),
+                 stage.sources.data(), nullptr);
+  glCompileShader(shader);
+
+  GLint success = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (!success) {
+    char infoLog[1024];
+    glGetShaderInfoLog(shader, sizeof(infoLog), nullptr, infoLog);
+    std::cerr << "Ошибка компиляции шейдера " << stageName(stage.type)
+              << " программы " << name << ":" << std::endl
+              << infoLog << std::endl;
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+}  // namespace
+
+ProgramCache& ProgramCache::instance() {
+  static ProgramCache cache;
+  return cache;
+}
+
+bool ProgramCache::isSupported() {
+  if (supported < 0) {
+    GLint formats = 0;
+    if (GLEW_ARB_get_program_binary) {
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    supported = formats > 0 ? 1 : 0;
+    if (!supported) {
+      std::cout << "Драйвер не сохраняет двоичные программы, кэш шейдеров "
+                   "выключен"
+                << std::endl;
+    }
+  }
+  return supported == 1;
+}
+
+uint64_t ProgramCache::makeKey(const char* const* sources, size_t count) {
+  if (!driverHashed) {
+    // Двоичная программа годится только для того же драйвера
+    uint64_t h = hashBytes(nullptr, 0);
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+      h = hashString(reinterpret_cast<const char*>(glGetString(name)), h);
+    }
+    driverHash = h;
+    driverHashed = true;
+  }
+
+  uint64_t key = hashBytes(&kDProgVersion, sizeof(kDProgVersion), driverHash);
+  for (size_t i = 0; i < count; i++) {
+    key = hashString(sources[i], key);
+  }
+  return key;
+}
+
+GLuint ProgramCache::build(const std::string& name,
+                           const std::vector<Stage>& stages,
+                           const std::vector<const char*>& keyExtras,
+                           const std::function<void(GLuint)>& beforeLink) {
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<const char*> keySources;
+  for (const Stage& stage : stages) {
+    keySources.insert(keySources.end(), stage.sources.begin(),
+                      stage.sources.end());
+  }
+  keySources.insert(keySources.end(), keyExtras.begin(), keyExtras.end());
+  const uint64_t key = makeKey(keySources.data(), keySources.size());
+
+  GLuint program = load(key, name);
+  const bool cached = program != 0;
+  if (!cached) {
+    program = link(name, stages, beforeLink);
+    if (program == 0) return 0;
+    store(key, program);
+  }
+
+  std::cout << "Программа " << name << (cached ? " из кэша: " : " собрана: ")
+            << std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count()
+            << " мс" << std::endl;
+  return program;
+}
+
+GLuint ProgramCache::link(const std::string& name,
+                          const std::vector<Stage>& stages,
+                          const std::function<void(GLuint)>& beforeLink) {
+  GLuint program = glCreateProgram();
+  bool compiled = true;
+  for (const Stage& stage : stages) {
+    GLuint shader = compileStage(name, stage);
+    if (shader == 0) {
+      compiled = false;
+      continue;
+    }
+    // Присоединённый шейдер удалится вместе с программой
+    glAttachShader(program, shader);
+    glDeleteShader(shader);
+  }
+  if (!compiled) {
+    glDeleteProgram(program);
+    return 0;
+  }
+
+  if (beforeLink) beforeLink(program);
+  prepare(program);
+  glLinkProgram(program);
+
+  GLint success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if (!success) {
+    char infoLog[1024];
+    glGetProgramInfoLog(program, sizeof(infoLog), nullptr, infoLog);
+    std::cerr << "Ошибка сборки программы " << name << ":" << std::endl
+              << infoLog << std::endl;
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
+std::string ProgramCache::cachePath(uint64_t key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.dprog",
+                static_cast<unsigned long long>(key));
+  return std::string(kCacheDirectory) + "/" + name;
+}
+
+GLuint ProgramCache::load(uint64_t key, const std::string& name) {
+  if (!isSupported()) return 0;
+
+  const std::string path = cachePath(key);
+  MappedFile file(path);
+  if (!file.isOpen()) {
+    stats.misses++;
+    return 0;
+  }
+
+  const DProgHeader* h = reinterpret_cast<const DProgHeader*>(file.data());
+  if (file.size() < sizeof(DProgHeader) ||
+      std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 ||
+      h->version != kDProgVersion || h->key != key ||
+      file.size() - sizeof(DProgHeader) != h->binarySize) {
+    std::cout << "Кэш программы устарел (формат): " << path << std::endl;
+    stats.misses++;
+    return 0;
+  }
+
+  const char* binary = file.data() + sizeof(DProgHeader);
+  if (hashBytes(binary, h->binarySize) != h->payloadHash) {
+    std::cerr << "Кэш программы повреждён: " << path << std::endl;
+    stats.misses++;
+    return 0;
+  }
+
+  GLuint program = glCreateProgram();
+  glProgramBinary(program, h->binaryFormat, binary,
+                  static_cast<GLsizei>(h->binarySize));
+  GLint linked = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    // Драйвер обновился без смены версии или сменил формат
+    std::cout << "Драйвер отверг программу " << name << " из кэша " << path
+              << ", собираем заново" << std::endl;
+    glDeleteProgram(program);
+    file.close();
+    std::remove(path.c_str());
+    stats.rejected++;
+    return 0;
+  }
+
+  stats.hits++;
+  return program;
+}
+
+void ProgramCache::prepare(GLuint program) {
+  if (isSupported()) {
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+}
+
+void ProgramCache::store(uint64_t key, GLuint program) {
+  if (!isSupported()) return;
+
+  GLint linked = 0, length = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (!linked || length <= 0) return;
+
+  std::vector<char> binary(static_cast<size_t>(length));
+  GLsizei written = 0;
+  GLenum format = 0;
+  glGetProgramBinary(program, length, &written, &format, binary.data());
+  if (written <= 0) return;
+  binary.resize(static_cast<size_t>(written));
+
+  DProgHeader h = {};
+  std::memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kDProgVersion;
+  h.key = key;
+  h.binaryFormat = format;
+  h.binarySize = static_cast<uint32_t>(binary.size());
+  h.payloadHash = hashBytes(binary.data(), binary.size());
+
+  std::error_code ec;
+  std::filesystem::create_directories(kCacheDirectory, ec);
+
+  if (!writeFileAtomically(cachePath(key),
+                           {{&h, sizeof(h)}, {binary.data(), binary.size()}})) {
+    return;
+  }
+  stats.stored++;
+}
@@ -0,0 +1,152 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "model.h"
+#include "shader.h"
+
+namespace {
+
+// Разрядность полей ключа
+constexpr unsigned int kPassBits = 2;
+constexpr unsigned int kFeatureBits = 8;
+constexpr unsigned int kTextureBits = 16;
+constexpr unsigned int kMeshBits = 16;
+constexpr unsigned int kDepthBits = 22;
+
+static_assert(kPassBits + kFeatureBits + kTextureBits + kMeshBits +
+                      kDepthBits ==
+                  64,
+              "Sort key fields must fill 64 bits");
+
+// Шаг глубины в ключе: 1/16 единицы мира, предел — 2^22/16 ≈ 262 км
+constexpr float kDepthSteps = 16.0f;
+
+uint64_t field(uint64_t value, unsigned int bits) {
+  return value & ((uint64_t(1) << bits) - 1);
+}
+
+}  // namespace
+
+void RenderQueue::begin() {
+  packets.clear();
+  stats = {};
+}
+
+void RenderQueue::submit(const Model& model, RenderPass pass,
+                         const Frustum& frustum, const LodView& lodView,
+                         float alpha) {
+  model.prepareVisibleInstances(frustum, lodView);
+  if (model.getCullStats().visible == 0) return;
+
+  DrawPacket packet;
+  packet.key = makeKey(pass, model.getShaderFeatures(),
+                       model.getDrawTexture(),
+                       model.getMesh().getVertexArray(),
+                       model.getNearestDistance());
+  packet.model = &model;
+  packet.alpha = alpha;
+  packets.push_back(packet);
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, unsigned int features,
+                              GLuint texture, GLuint mesh, float depth) {
+  // NaN clamp пропускает, а его приведение к целому не определено
+  if (!std::isfinite(depth)) depth = 0.0f;
+  const float maxDepth = float((1u << kDepthBits) - 1);
+  const uint64_t quantized =
+      uint64_t(std::clamp(depth * kDepthSteps, 0.0f, maxDepth));
+
+  // Имена объектов OpenGL — небольшие числа, младших битов хватает, чтобы
+  // одинаковые состояния шли подряд
+  const uint64_t state =
+      field(features, kFeatureBits) << (kTextureBits + kMeshBits) |
+      field(texture, kTextureBits) << kMeshBits | field(mesh, kMeshBits);
+
+  uint64_t key = field(static_cast<uint32_t>(pass), kPassBits) << 62;
+  if (pass == RenderPass::Transparent) {
+    // Дальние раньше: глубина инвертируется и стоит перед состоянием
+    const uint64_t inverted = field(~quantized, kDepthBits);
+    key |= inverted << (64 - kPassBits - kDepthBits) | state;
+  } else {
+    key |= state << kDepthBits | quantized;
+  }
+  return key;
+}
+
+void RenderQueue::sortPackets() {
+  // Поразрядная сортировка по байтам ключа от младшего к старшему.
+  // Байты, одинаковые у всех пакетов, пропускаются: в кадре несколько
+  // десятков пакетов и большая часть ключа у них совпадает.
+  uint64_t differ = 0;
+  for (const DrawPacket& packet : packets) {
+    differ |= packet.key ^ packets[0].key;
+  }
+
+  scratch.resize(packets.size());
+  for (unsigned int shift = 0; shift < 64; shift += 8) {
+    if (((differ >> shift) & 0xFF) == 0) continue;
+
+    size_t offsets[256] = {};
+    for (const DrawPacket& packet : packets) {
+      offsets[(packet.key >> shift) & 0xFF]++;
+    }
+    size_t sum = 0;
+    for (size_t& offset : offsets) {
+      const size_t count = offset;
+      offset = sum;
+      sum += count;
+    }
+    for (const DrawPacket& packet : packets) {
+      scratch[offsets[(packet.key >> shift) & 0xFF]++] = packet;
+    }
+    packets.swap(scratch);
+  }
+}
+
+void RenderQueue::execute(Shader& shader) {
+  stats.packets = packets.size();
+  if (packets.empty()) return;
+  sortPackets();
+
+  // Состояние, оставленное предыдущим пакетом. Первый пакет выставляет
+  // всё, потому что до очереди программу и текстуру мог менять кто угодно.
+  bool first = true;
+  unsigned int features = 0;
+  GLenum target = GL_TEXTURE_2D;
+  GLuint texture = 0;
+  float alpha = 1.0f;
+
+  glActiveTexture(GL_TEXTURE0);
+  for (const DrawPacket& packet : packets) {
+    const Model& model = *packet.model;
+    const bool programChanged =
+        first || model.getShaderFeatures() != features;
+    if (programChanged) {
+      features = model.getShaderFeatures();
+      shader.use(features);
+      stats.programChanges++;
+    }
+    // Модели на массиве текстур делят одну привязку
+    if (first || model.getTextureTarget() != target ||
+        model.getDrawTexture() != texture) {
+      target = model.getTextureTarget();
+      texture = model.getDrawTexture();
+      glBindTexture(target, texture);
+      stats.textureChanges++;
+    }
+    // alpha у каждого варианта своя, поэтому после смены программы
+    // выставляется заново; совпавшее значение Shader не отправит в GL
+    if (programChanged || packet.alpha != alpha) {
+      alpha = packet.alpha;
+      shader.setFloat("alpha", alpha);
+    }
+    first = false;
+
+    model.drawPrepared(shader);
+    stats.drawCalls += model.getCullStats().drawCalls;
+  }
+  // Модели оставляют привязанным VAO арены
+  glBindVertexArray(0);
+}
@@ -1,75 +1,113 @@
 #include "shader.h"
 
-const char* vertexShaderSource = R"(
-#version 330 core
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+#include "program_cache.h"
 
-layout(location = 0) in vec3 position;
+// Both stages are compiled after "#version" and the feature #defines of
+// the variant, see Shader::compileVariant()
+const char* vertexShaderSource = R"(
+layout(location = 0) in vec3 packedPosition; // Raw or bounding box fraction
 layout(location = 1) in vec2 texCoord;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in mat4 instanceMatrix; // Instanced transform
+layout(location = 7) in vec4 instanceNormalScale; // 1 / scale^2 per axis,
+                                                  // w: impostor share
+#ifdef TEXTURE_ARRAY
+layout(location = 8) in float instanceLayer; // See kTextureLayerAttribute
+#endif
 
-uniform mat4 view;
-uniform mat4 projection;
-uniform float time;
-uniform float windStrength;
-uniform float windFrequency;
-uniform int animate; // 0 = no animation, 1 = animate
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// Per-frame data shared by every model, see FrameUniforms
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    DirLight dirLight;
+    float time;
+    float windStrength;
+    float windFrequency;
+};
+
+uniform vec3 positionOffset = vec3(0.0); // Mesh position decode
+uniform vec3 positionScale = vec3(1.0);
 
 out vec2 TexCoord;
 out vec3 Normal;
 out vec3 FragPos;
 out float Alpha;
+#ifdef IMPOSTOR_FADE
+flat out float Fade;
+#endif
+#ifdef TEXTURE_ARRAY
+flat out float Layer;
+#endif
 
 void main() {
+    vec3 position = positionOffset + packedPosition * positionScale;
     vec3 animatedPosition = position;
     
-    // Apply wind animation to trees, clouds, and balloons
-    if (animate == 1) {
-        float windEffect = 0.0;
-        
-        // Different animations based on object type
-        // Trees: swaying motion
-        if (abs(position.y) > 0.5) { // Assuming trees are tall
-            windEffect = sin(time * windFrequency + position.x * 0.1) * 
-                        windStrength * 0.1 * (position.y * 0.5);
-            animatedPosition.x += windEffect;
-            animatedPosition.z += cos(time * windFrequency * 0.8 + position.z * 0.1) * 
-                                windStrength * 0.05 * (position.y * 0.5);
-        }
-        // Clouds: gentle floating
-        else if (abs(position.y) < 0.5 && abs(position.x) < 1.0) { // Assuming clouds are flat
-            windEffect = sin(time * windFrequency * 0.3 + position.x) * 
-                        windStrength * 0.05;
-            animatedPosition.x += windEffect;
-            animatedPosition.y += cos(time * windFrequency * 0.4 + position.z) * 
-                                windStrength * 0.02;
-        }
-        // Balloons: gentle bobbing
-        else {
-            windEffect = sin(time * windFrequency * 0.5 + position.x) * 
-                        windStrength * 0.03;
-            animatedPosition.y += windEffect;
-        }
-    }
-    
+    // Wind animation; each variant compiles in only its own motion
+#ifdef TREE_SWAY
+    // Trees: swaying motion that grows with height
+    animatedPosition.x += sin(time * windFrequency + position.x * 0.1) *
+                          windStrength * 0.1 * (position.y * 0.5);
+    animatedPosition.z += cos(time * windFrequency * 0.8 + position.z * 0.1) *
+                          windStrength * 0.05 * (position.y * 0.5);
+#endif
+#ifdef CLOUD_DRIFT
+    // Clouds: gentle floating
+    animatedPosition.x += sin(time * windFrequency * 0.3 + position.x) *
+                          windStrength * 0.05;
+    animatedPosition.y += cos(time * windFrequency * 0.4 + position.z) *
+                          windStrength * 0.02;
+#endif
+#ifdef BALLOON_BOB
+    // Balloons: gentle bobbing
+    animatedPosition.y += sin(time * windFrequency * 0.5 + position.x) *
+                          windStrength * 0.03;
+#endif
+
     // Apply instance transformation
     vec4 worldPosition = instanceMatrix * vec4(animatedPosition, 1.0);
     
     gl_Position = projection * view * worldPosition;
 
     TexCoord = texCoord;
-    Normal = mat3(transpose(inverse(instanceMatrix))) * normal;
+    // Normal matrix of T * R * S is R * S^-1 = mat3(instanceMatrix) * S^-2,
+    // so the CPU supplies S^-2 instead of inverting per vertex
+    Normal = mat3(instanceMatrix) * (normal * instanceNormalScale.xyz);
     FragPos = vec3(worldPosition);
     Alpha = 1.0;
+#ifdef IMPOSTOR_FADE
+    Fade = instanceNormalScale.w;
+#endif
+#ifdef TEXTURE_ARRAY
+    Layer = instanceLayer;
+#endif
 }
 )";
 
 const char* fragmentShaderSource = R"(
-#version 330 core
 in vec2 TexCoord;
 in vec3 Normal;
 in vec3 FragPos;
 in float Alpha;
+#ifdef IMPOSTOR_FADE
+flat in float Fade;
+#endif
+#ifdef TEXTURE_ARRAY
+flat in float Layer;
+#endif
 
 out vec4 FragColor;
 
@@ -80,17 +118,54 @@ struct DirLight {
     vec3 specular;
 };
 
+// Per-frame data shared by every model, see FrameUniforms
+layout(std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    DirLight dirLight;
+    float time;
+    float windStrength;
+    float windFrequency;
+};
+
+#ifdef TEXTURE_ARRAY
+uniform sampler2DArray textureSampler;
+#else
 uniform sampler2D textureSampler;
-uniform vec3 viewPos;
-uniform DirLight dirLight;
+#endif
 uniform float alpha = 1.0; // Override alpha for specific objects
 
+#ifdef IMPOSTOR_FADE
+// Ordered 4x4 Bayer threshold in (0, 1)
+float ditherThreshold() {
+    const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0,
+                                      12.0, 4.0, 14.0, 6.0,
+                                      3.0, 11.0, 1.0, 9.0,
+                                      15.0, 7.0, 13.0, 5.0);
+    ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+    return (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+}
+#endif
+
 void main() {
+#ifdef IMPOSTOR_FADE
+    // Cross-fade into an impostor: leave the pixels it will cover
+    if (Fade > 0.0 && ditherThreshold() < Fade) discard;
+#endif
+
+#ifdef TEXTURE_ARRAY
+    vec4 texColor = texture(textureSampler, vec3(TexCoord, Layer));
+#else
     vec4 texColor = texture(textureSampler, TexCoord);
+#endif
     
     // Use the smaller of the two alpha values
     float finalAlpha = min(texColor.a, alpha * Alpha);
+#ifdef ALPHA_TEST
+    // Cut-out texels; opaque variants keep early depth testing
     if (finalAlpha < 0.1) discard;
+#endif
     
     vec3 norm = normalize(Normal);
     vec3 lightDir = normalize(-dirLight.direction);
@@ -113,70 +188,145 @@ void main() {
 }
 )";
 
-Shader::Shader() {
-    GLuint vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
-
-    GLuint fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
-
-    programID = glCreateProgram();
-    glAttachShader(programID, vertex);
-    glAttachShader(programID, fragment);
-    glLinkProgram(programID);
-    checkCompileErrors(programID, "PROGRAM");
-
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
-}
+namespace {
+
+// Preprocessor flag of every ShaderFeature bit, in bit order
+const char* const featureDefines[] = {
+    "TREE_SWAY", "CLOUD_DRIFT", "BALLOON_BOB", "ALPHA_TEST", "IMPOSTOR_FADE",
+    "TEXTURE_ARRAY",
+};
+
+} // namespace
 
 Shader::~Shader() {
-    glDeleteProgram(programID);
+    for (auto& [features, variant] : variants) {
+        glDeleteProgram(variant.programID);
+    }
 }
 
-void Shader::use() const {
-    glUseProgram(programID);
+void Shader::use(unsigned int features) {
+    auto it = variants.find(features);
+    if (it == variants.end()) {
+        it = variants.emplace(features, Variant()).first;
+        compileVariant(features, it->second);
+        current = &it->second;
+        glUseProgram(current->programID);
+        // Every model binds its texture to unit 0
+        setInt("textureSampler", 0);
+        return;
+    }
+    current = &it->second;
+    glUseProgram(current->programID);
+}
+
+void Shader::prepare(unsigned int features) {
+    if (variants.count(features) != 0) return;
+
+    Variant* previous = current;
+    use(features);
+    current = previous;
+    glUseProgram(previous ? previous->programID : 0);
+}
+
+GLuint Shader::getProgram() const {
+    return current ? current->programID : 0;
+}
+
+void Shader::compileVariant(unsigned int features, Variant& variant) {
+    std::string defines = "#version 330 core\n";
+    std::string name;
+    for (size_t bit = 0; bit < std::size(featureDefines); bit++) {
+        if (features & (1u << bit)) {
+            defines += std::string("#define ") + featureDefines[bit] + "\n";
+            name += std::string(name.empty() ? "" : " ") +
+                featureDefines[bit];
+        }
+    }
+    if (name.empty()) name = "STATIC";
+
+    // A binary from an earlier launch skips compiling and linking
+    variant.programID = ProgramCache::instance().build("сцены " + name, {
+        {GL_VERTEX_SHADER, {defines.c_str(), vertexShaderSource}},
+        {GL_FRAGMENT_SHADER, {defines.c_str(), fragmentShaderSource}},
+    });
+    if (variant.programID == 0) return;
+
+    GLuint frameBlock =
+        glGetUniformBlockIndex(variant.programID, "FrameData");
+    if (frameBlock != GL_INVALID_INDEX) {
+        glUniformBlockBinding(variant.programID, frameBlock,
+            kFrameUniformBinding);
+    }
+    reflectUniforms(variant);
 }
 
 void Shader::setMat4(const std::string& name, const glm::mat4& mat) const {
-    glUniformMatrix4fv(glGetUniformLocation(programID, name.c_str()),
-        1, GL_FALSE, &mat[0][0]);
+    if (const Uniform* uniform = shadow(name, &mat[0][0], sizeof(mat))) {
+        glUniformMatrix4fv(uniform->location, 1, GL_FALSE, &mat[0][0]);
+    }
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& vec) const {
-    glUniform3fv(glGetUniformLocation(programID, name.c_str()), 1, &vec[0]);
+    if (const Uniform* uniform = shadow(name, &vec[0], sizeof(vec))) {
+        glUniform3fv(uniform->location, 1, &vec[0]);
+    }
 }
 
 void Shader::setFloat(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(programID, name.c_str()), value);
+    if (const Uniform* uniform = shadow(name, &value, sizeof(value))) {
+        glUniform1f(uniform->location, value);
+    }
 }
 
 void Shader::setInt(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(programID, name.c_str()), value);
+    if (const Uniform* uniform = shadow(name, &value, sizeof(value))) {
+        glUniform1i(uniform->location, value);
+    }
 }
 
-void Shader::checkCompileErrors(GLuint shader, const std::string& type) {
-    int success;
-    char infoLog[1024];
+void Shader::reflectUniforms(Variant& variant) {
+    GLuint programID = variant.programID;
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> buffer(std::max(maxLength, 1));
+
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(programID, static_cast<GLuint>(i),
+            static_cast<GLsizei>(buffer.size()), &length, &size, &type,
+            buffer.data());
+        std::string name(buffer.data(), length);
 
-    if (type != "PROGRAM") {
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-        if (!success) {
-            glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-            std::cerr << "Shader compilation error " << type << ":" << std::endl
-                << infoLog << std::endl;
+        // Block members have no location and are set through the buffer
+        GLint location = glGetUniformLocation(programID, name.c_str());
+        if (location < 0) continue;
+
+        // Arrays are reported as "name[0]"
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+            name.resize(name.size() - 3);
         }
+        variant.uniforms[name].location = location;
     }
-    else {
-        glGetProgramiv(shader, GL_LINK_STATUS, &success);
-        if (!success) {
-            glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-            std::cerr << "Program linking error:" << std::endl
-                << infoLog << std::endl;
-        }
+}
+
+// Remember the value in the current variant; returns the uniform to upload
+// to, or nullptr when it is inactive or already holds this value
+const Shader::Uniform* Shader::shadow(const std::string& name,
+                                      const void* data, size_t size) const {
+    if (!current) return nullptr;
+    auto it = current->uniforms.find(name);
+    if (it == current->uniforms.end()) return nullptr;
+
+    Uniform& uniform = it->second;
+    if (uniform.hasValue && std::memcmp(uniform.value, data, size) == 0) {
+        uniformSkips++;
+        return nullptr;
     }
-}
\ No newline at end of file
+    std::memcpy(uniform.value, data, size);
+    uniform.hasValue = true;
+    uniformUploads++;
+    return &uniform;
+}
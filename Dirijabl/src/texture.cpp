@@ -0,0 +1,295 @@
+#include "texture.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mapped_file.h"
+#include "texture_cooker.h"
+
+bool TextureData::read(const std::string& filename) {
+  ok = false;
+  cooked = false;
+  if (!checkFile(filename)) {
+    return false;
+  }
+
+  if (cache.open(filename)) {
+    if (cache.getFormat() != DTexFormat::RGBA8 &&
+        !GLEW_EXT_texture_compression_s3tc) {
+      // Без S3TC в драйвере остаётся исходное изображение
+      cache.close();
+    } else {
+      std::cout << "Текстура из кэша " << TextureCache::cachePath(filename)
+                << ": " << dtexFormatName(cache.getFormat()) << ", "
+                << cache.getMipCount() << " уровней" << std::endl;
+      cooked = true;
+      ok = true;
+      return true;
+    }
+  }
+
+  if (!image.loadFromFile(filename)) {
+    std::cerr << "Не удалось загрузить текстуру: " << filename << std::endl;
+    return false;
+  }
+
+  ok = true;
+  return true;
+}
+
+void TextureData::copyTo(void* dst) const {
+  if (cooked) {
+    std::memcpy(dst, cache.getPayload(), cache.getPayloadSize());
+    return;
+  }
+
+  sf::Vector2u size = image.getSize();
+  const size_t rowBytes = static_cast<size_t>(size.x) * 4;
+  const sf::Uint8* src = image.getPixelsPtr();
+  unsigned char* out = static_cast<unsigned char*>(dst);
+
+  for (unsigned int y = 0; y < size.y; y++) {
+    std::memcpy(out + y * rowBytes, src + (size.y - 1 - y) * rowBytes,
+                rowBytes);
+  }
+}
+
+size_t TextureData::getByteSize() const {
+  if (cooked) return cache.getPayloadSize();
+  sf::Vector2u size = image.getSize();
+  return static_cast<size_t>(size.x) * size.y * 4;
+}
+
+GLenum compressedFormat(DTexFormat format) {
+  return format == DTexFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+                                   : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+Texture::~Texture() {
+  releaseStaging();
+  if (id != 0) glDeleteTextures(1, &id);
+}
+
+void Texture::create() {
+  glGenTextures(1, &id);
+  glBindTexture(GL_TEXTURE_2D, id);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool Texture::load(const std::string& filename) {
+  if (id != 0 && status != Status::Unloaded) {
+    std::cerr << "Текстура уже загружена" << std::endl;
+    return false;
+  }
+
+  this->filename = filename;
+  TextureData data;
+  if (!data.read(filename)) {
+    status = Status::Failed;
+    return false;
+  }
+
+  if (!apply(data)) {
+    return false;
+  }
+  std::cout << "Текстура загружена: " << filename << std::endl;
+  return true;
+}
+
+void Texture::beginAsyncLoad(const std::string& filename) {
+  if (id == 0) create();
+  this->filename = filename;
+
+  // Белый пиксель, чтобы модель до загрузки была видна с освещением
+  setPlaceholder();
+  status = Status::Loading;
+}
+
+void Texture::setPlaceholder() {
+  const unsigned char white[4] = {255, 255, 255, 255};
+  glBindTexture(GL_TEXTURE_2D, id);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               white);
+
+  // Уровни прежнего изображения задаются пустыми, и драйвер их освобождает
+  GLint maxLevel = 0;
+  if (!uploadLevels.empty()) {
+    const DTexLevel& base = uploadLevels[0];
+    maxLevel = static_cast<GLint>(uploadLevels.size()) - 1;
+    for (uint32_t size = std::max(base.width, base.height);
+         generateMipmaps && size > 1; size /= 2) {
+      maxLevel++;
+    }
+  }
+  for (GLint level = 1; level <= maxLevel; level++) {
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, 0, 0, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  byteSize = 4;
+}
+
+void* Texture::beginUpload(const TextureData& data) {
+  if (!data.ok || mapped) return nullptr;
+  if (id == 0) create();
+
+  // Прошлая заливка могла ещё не завершиться: старый буфер освобождается,
+  // драйвер удалит его после выполнения команд
+  releaseStaging();
+
+  const size_t bytes = data.getByteSize();
+  glGenBuffers(1, &pbo);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+  glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+  void* ptr = glMapBufferRange(
+      GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  if (!ptr) {
+    std::cerr << "Не удалось отобразить буфер распаковки текстуры"
+              << std::endl;
+    releaseStaging();
+    return nullptr;
+  }
+
+  uploadLevels.clear();
+  if (data.cooked) {
+    const TextureCache& cache = data.cache;
+    uploadFormat = cache.getFormat();
+    for (uint32_t i = 0; i < cache.getMipCount(); i++) {
+      uploadLevels.push_back(cache.getLevel(i));
+    }
+    generateMipmaps = false;
+  } else {
+    sf::Vector2u size = data.image.getSize();
+    uploadFormat = DTexFormat::RGBA8;
+    uploadLevels.push_back({size.x, size.y, 0, bytes});
+    generateMipmaps = true;
+  }
+  mapped = true;
+  status = Status::Uploading;
+  return ptr;
+}
+
+bool Texture::finishUpload() {
+  if (!mapped) return false;
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+  mapped = false;
+  if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) != GL_TRUE) {
+    // Содержимое буфера потеряно, например при смене видеорежима
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    std::cerr << "Содержимое буфера распаковки текстуры потеряно"
+              << std::endl;
+    releaseStaging();
+    status = Status::Failed;
+    return false;
+  }
+
+  // С привязанным PBO последний аргумент — смещение в буфере, и
+  // glTexImage2D возвращается, не дожидаясь копирования
+  glBindTexture(GL_TEXTURE_2D, id);
+  byteSize = 0;
+  for (size_t i = 0; i < uploadLevels.size(); i++) {
+    const DTexLevel& level = uploadLevels[i];
+    const void* offset = reinterpret_cast<const void*>(level.offset);
+    if (uploadFormat == DTexFormat::RGBA8) {
+      glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, level.width, level.height, 0,
+                   GL_RGBA, GL_UNSIGNED_BYTE, offset);
+    } else {
+      glCompressedTexImage2D(GL_TEXTURE_2D, i, compressedFormat(uploadFormat),
+                             level.width, level.height, 0, level.size,
+                             offset);
+    }
+    byteSize += level.size;
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  if (generateMipmaps) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    // Мип-уровни, построенные GPU, тоже занимают память
+    const DTexLevel& base = uploadLevels[0];
+    for (uint32_t w = base.width, h = base.height; w > 1 || h > 1;) {
+      w = std::max(1u, w / 2);
+      h = std::max(1u, h / 2);
+      byteSize += levelByteSize(DTexFormat::RGBA8, w, h);
+    }
+  } else {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                    static_cast<GLint>(uploadLevels.size()) - 1);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  status = Status::Uploading;
+  return true;
+}
+
+bool Texture::apply(const TextureData& data) {
+  void* ptr = beginUpload(data);
+  if (!ptr) {
+    if (data.ok) status = Status::Failed;
+    return false;
+  }
+  data.copyTo(ptr);
+  return finishUpload();
+}
+
+void Texture::markFailed() {
+  releaseStaging();
+  status = Status::Failed;
+}
+
+Texture::Status Texture::pollStatus() {
+  if (status != Status::Uploading || mapped) return status;
+
+  if (fence) {
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) return status;
+    if (result == GL_WAIT_FAILED) {
+      std::cerr << "Ошибка ожидания заливки текстуры" << std::endl;
+    }
+  }
+
+  // Буфер распаковки больше не нужен
+  releaseStaging();
+  status = Status::Ready;
+  return status;
+}
+
+void Texture::unload() {
+  // Заливку не прервать: выгружается только окончательное изображение
+  if (status != Status::Ready) return;
+
+  releaseStaging();
+  setPlaceholder();
+  status = Status::Unloaded;
+}
+
+void Texture::releaseStaging() {
+  if (fence) {
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+  if (pbo != 0) {
+    if (mapped) {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      mapped = false;
+    }
+    glDeleteBuffers(1, &pbo);
+    pbo = 0;
+  }
+}
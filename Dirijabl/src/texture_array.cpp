@@ -0,0 +1,310 @@
+#include "texture_array.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "asset_registry.h"
+#include "program_cache.h"
+#include "texture_cache.h"
+
+namespace {
+
+const char* copyVertexSource = R"(
+#version 330 core
+
+out vec2 TexCoord;
+
+void main() {
+    // One triangle over the whole layer: (0,0), (2,0), (0,2) in UV
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoord = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+const char* copyFragmentSource = R"(
+#version 330 core
+
+in vec2 TexCoord;
+out vec4 FragColor;
+
+uniform sampler2D source;
+
+void main() {
+    // Source mip levels keep the downscale filtered
+    FragColor = texture(source, TexCoord);
+}
+)";
+
+}  // namespace
+
+TextureArray::TextureArray() {
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxLayerSize);
+  maxLayerSize = std::max<GLint>(maxLayerSize, 1);
+
+  program = ProgramCache::instance().build(
+      "копирования в массив текстур",
+      {{GL_VERTEX_SHADER, {copyVertexSource}},
+       {GL_FRAGMENT_SHADER, {copyFragmentSource}}});
+  if (program == 0) return;
+
+  glUseProgram(program);
+  glUniform1i(glGetUniformLocation(program, "source"), 0);
+  glUseProgram(0);
+
+  glGenTextures(1, &id);
+  glGenFramebuffers(1, &framebuffer);
+  glGenVertexArrays(1, &vao);
+}
+
+TextureArray::~TextureArray() {
+  if (program != 0) glDeleteProgram(program);
+  if (id != 0) glDeleteTextures(1, &id);
+  if (framebuffer != 0) glDeleteFramebuffers(1, &framebuffer);
+  if (vao != 0) glDeleteVertexArrays(1, &vao);
+}
+
+int TextureArray::addTexture(const std::shared_ptr<Texture>& texture) {
+  if (!isValid() || !texture) return -1;
+
+  for (size_t i = 0; i < layers.size(); i++) {
+    if (layers[i].texture == texture) return static_cast<int>(i);
+  }
+  Layer layer;
+  layer.texture = texture;
+  layers.push_back(layer);
+  return static_cast<int>(layers.size() - 1);
+}
+
+void TextureArray::printStats() const {
+  std::cout << "Массив текстур: слоёв " << capacity << " по " << layerWidth
+            << "x" << layerHeight << " " << dtexFormatName(format) << ", "
+            << getByteSize() / 1024 << " КБ"
+            << (complete ? ", исходные текстуры выгружены" : "") << std::endl;
+}
+
+void TextureArray::setSampling() const {
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+void TextureArray::allocate(size_t layerCount) {
+  // Слоёв ровно столько, сколько текстур: их добавляют при настройке
+  // моделей, а не каждый кадр
+  capacity = layerCount;
+  format = DTexFormat::RGBA8;
+  layerWidth = layerHeight = std::min<GLsizei>(kLayerSize, maxLayerSize);
+  levels = 1;
+  while ((layerWidth >> levels) > 0) levels++;
+
+  // Имя массива не меняется, поэтому модели могут его запомнить; прежнее
+  // содержимое пропадает, и все слои заполняются заново
+  glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+  layerBytes = 0;
+  for (GLsizei level = 0; level < levels; level++) {
+    const GLsizei size = std::max<GLsizei>(layerWidth >> level, 1);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, size, size,
+                 static_cast<GLsizei>(capacity), 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, nullptr);
+    layerBytes += static_cast<size_t>(size) * size * 4;
+  }
+  setSampling();
+  for (Layer& layer : layers) layer.filled = false;
+  complete = false;
+}
+
+bool TextureArray::canCompress() const {
+  const Texture& first = *layers[0].texture;
+  if (first.getFormat() == DTexFormat::RGBA8) return false;
+
+  const std::vector<DTexLevel>& chain = first.getLevels();
+  for (const Layer& layer : layers) {
+    const Texture& texture = *layer.texture;
+    if (texture.getStatus() != Texture::Status::Ready ||
+        texture.getFormat() != first.getFormat() ||
+        texture.getLevels().size() != chain.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < chain.size(); i++) {
+      const DTexLevel& level = texture.getLevels()[i];
+      if (level.width != chain[i].width || level.height != chain[i].height ||
+          level.size != chain[i].size) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool TextureArray::uploadCompressed() {
+  const std::vector<DTexLevel> chain = layers[0].texture->getLevels();
+  format = layers[0].texture->getFormat();
+  const GLenum internalFormat = compressedFormat(format);
+  layerWidth = static_cast<GLsizei>(chain[0].width);
+  layerHeight = static_cast<GLsizei>(chain[0].height);
+  levels = static_cast<GLsizei>(chain.size());
+
+  // Сжатые уровни нельзя ни рисовать, ни строить на GPU: они берутся из
+  // .dtex как есть, поэтому размер слоя — размер текстур
+  glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+  layerBytes = 0;
+  for (GLsizei level = 0; level < levels; level++) {
+    glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat,
+                           chain[level].width, chain[level].height,
+                           static_cast<GLsizei>(capacity), 0,
+                           static_cast<GLsizei>(chain[level].size * capacity),
+                           nullptr);
+    layerBytes += chain[level].size;
+  }
+  setSampling();
+
+  for (size_t i = 0; i < layers.size(); i++) {
+    const std::string& filename = layers[i].texture->getFilename();
+    TextureCache cache;
+    bool matches = cache.open(filename) && cache.getFormat() == format &&
+                   cache.getMipCount() == chain.size();
+    for (uint32_t level = 0; matches && level < chain.size(); level++) {
+      matches = cache.getLevel(level).size == chain[level].size;
+    }
+    if (!matches) {
+      std::cerr << "Кэш текстуры не подошёл для сжатого массива: "
+                << filename << std::endl;
+      return false;
+    }
+
+    for (uint32_t level = 0; level < chain.size(); level++) {
+      const DTexLevel& data = cache.getLevel(level);
+      glCompressedTexSubImage3D(
+          GL_TEXTURE_2D_ARRAY, level, 0, 0, static_cast<GLint>(i),
+          data.width, data.height, 1, internalFormat,
+          static_cast<GLsizei>(data.size), cache.getPayload() + data.offset);
+    }
+    layers[i].filled = true;
+    layers[i].filledStatus = Texture::Status::Ready;
+  }
+  return true;
+}
+
+void TextureArray::update() {
+  if (!isValid() || layers.empty()) return;
+
+  // Сохранить привязки текстур: allocate(), заливка и мип-уровни их меняют
+  GLint previousActiveTexture = 0, previousArray = 0, previousTexture = 0;
+  glGetIntegerv(GL_ACTIVE_TEXTURE, &previousActiveTexture);
+  glActiveTexture(GL_TEXTURE0);
+  glGetIntegerv(GL_TEXTURE_BINDING_2D_ARRAY, &previousArray);
+  glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+
+  if (capacity < layers.size()) {
+    // Выгруженные текстуры уже не скопировать, они загружаются заново
+    for (const Layer& layer : layers) {
+      AssetRegistry::instance().reloadTexture(layer.texture);
+    }
+    allocate(layers.size());
+  }
+
+  bool loaded = true;
+  for (const Layer& layer : layers) {
+    const Texture::Status status = layer.texture->getStatus();
+    if (status != Texture::Status::Ready &&
+        status != Texture::Status::Failed) {
+      loaded = false;
+    }
+  }
+
+  if (!complete && loaded && compressible && canCompress()) {
+    if (uploadCompressed()) {
+      complete = true;
+    } else {
+      // Остаётся RGBA8: слои перерисуются из ещё не выгруженных текстур
+      compressible = false;
+      allocate(capacity);
+    }
+  }
+
+  if (!complete) {
+    // Пока текстура заливается, её имя ещё показывает заглушку или старое
+    // содержимое; слой дождётся конца заливки
+    std::vector<size_t> dirty;
+    for (size_t i = 0; i < layers.size(); i++) {
+      const Layer& layer = layers[i];
+      const Texture::Status status = layer.texture->getStatus();
+      if (status == Texture::Status::Empty ||
+          status == Texture::Status::Uploading ||
+          status == Texture::Status::Unloaded) {
+        continue;
+      }
+      if (!layer.filled || layer.filledStatus != status) dirty.push_back(i);
+    }
+    if (!dirty.empty()) copyLayers(dirty);
+
+    complete = loaded && std::all_of(layers.begin(), layers.end(),
+                                     [](const Layer& layer) {
+                                       return layer.filled &&
+                                              layer.filledStatus ==
+                                                  layer.texture->getStatus();
+                                     });
+  }
+
+  // Исходные текстуры больше не нужны. Загруженная заново после выключения
+  // массива выгружается, как только дойдёт до GPU.
+  if (complete) {
+    for (const Layer& layer : layers) layer.texture->unload();
+  }
+
+  glBindTexture(GL_TEXTURE_2D, previousTexture);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, previousArray);
+  glActiveTexture(previousActiveTexture);
+}
+
+void TextureArray::copyLayers(const std::vector<size_t>& dirty) {
+  // Сохранить состояние, которое меняет копирование
+  GLint previousFramebuffer = 0, previousProgram = 0, previousVAO = 0;
+  GLint previousViewport[4];
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+  glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+  glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+  glGetIntegerv(GL_VIEWPORT, previousViewport);
+  const GLboolean blend = glIsEnabled(GL_BLEND);
+  const GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+  const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(0, 0, layerWidth, layerHeight);
+  glDisable(GL_BLEND);
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_DEPTH_TEST);
+  glUseProgram(program);
+  glBindVertexArray(vao);
+
+  for (size_t i : dirty) {
+    Layer& layer = layers[i];
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, id, 0,
+                              static_cast<GLint>(i));
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+      std::cerr << "Кадровый буфер для слоя " << i
+                << " массива текстур не готов" << std::endl;
+      continue;
+    }
+    glBindTexture(GL_TEXTURE_2D, layer.texture->id);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    layer.filled = true;
+    layer.filledStatus = layer.texture->getStatus();
+  }
+
+  glBindVertexArray(previousVAO);
+  glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+  glUseProgram(previousProgram);
+  glViewport(previousViewport[0], previousViewport[1], previousViewport[2],
+             previousViewport[3]);
+  if (blend) glEnable(GL_BLEND);
+  if (cullFace) glEnable(GL_CULL_FACE);
+  if (depthTest) glEnable(GL_DEPTH_TEST);
+
+  glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+  glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+}
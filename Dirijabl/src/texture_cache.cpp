@@ -0,0 +1,126 @@
+#include "texture_cache.h"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr char kMagic[4] = {'D', 'T', 'E', 'X'};
+
+}  // namespace
+
+const char* dtexFormatName(DTexFormat format) {
+  switch (format) {
+    case DTexFormat::BC1:
+      return "BC1";
+    case DTexFormat::BC3:
+      return "BC3";
+    default:
+      return "RGBA8";
+  }
+}
+
+std::string TextureCache::cachePath(const std::string& imagePath) {
+  return imagePath + ".dtex";
+}
+
+DTexFormat TextureCache::getFormat() const {
+  return header ? static_cast<DTexFormat>(header->format) : DTexFormat::RGBA8;
+}
+
+bool TextureCache::open(const std::string& imagePath) {
+  close();
+
+  const std::string path = cachePath(imagePath);
+  if (!file.open(path)) return false;
+
+  if (file.size() < sizeof(DTexHeader)) {
+    close();
+    return false;
+  }
+
+  const DTexHeader* h = reinterpret_cast<const DTexHeader*>(file.data());
+  const size_t tableSize = static_cast<size_t>(h->mipCount) * sizeof(DTexLevel);
+
+  if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0 ||
+      h->version != kDTexVersion ||
+      h->format > static_cast<uint32_t>(DTexFormat::BC3) ||
+      h->mipCount == 0 || h->mipCount > 32 ||
+      file.size() < sizeof(DTexHeader) + tableSize) {
+    std::cout << "Кэш текстуры устарел (формат): " << path << std::endl;
+    close();
+    return false;
+  }
+
+  // Уровни должны целиком лежать внутри файла
+  const DTexLevel* table =
+      reinterpret_cast<const DTexLevel*>(file.data() + sizeof(DTexHeader));
+  const size_t dataSize = file.size() - sizeof(DTexHeader) - tableSize;
+  for (uint32_t i = 0; i < h->mipCount; i++) {
+    if (table[i].offset > dataSize ||
+        table[i].size > dataSize - table[i].offset) {
+      std::cerr << "Кэш текстуры повреждён: " << path << std::endl;
+      close();
+      return false;
+    }
+  }
+
+  if (!sourceMatches(imagePath, h->sourceSize, h->sourceMtime, h->sourceHash,
+                     path, offsetof(DTexHeader, sourceMtime))) {
+    std::cout << "Кэш текстуры устарел (исходник изменён): " << path
+              << std::endl;
+    close();
+    return false;
+  }
+
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(file.data()) +
+                        sizeof(DTexHeader) + tableSize;
+  if (hashBytes(data, dataSize) != h->payloadHash) {
+    std::cerr << "Кэш текстуры повреждён: " << path << std::endl;
+    close();
+    return false;
+  }
+
+  header = h;
+  levels = table;
+  payload = data;
+  payloadSize = dataSize;
+  return true;
+}
+
+void TextureCache::close() {
+  file.close();
+  header = nullptr;
+  levels = nullptr;
+  payload = nullptr;
+  payloadSize = 0;
+}
+
+bool TextureCache::write(const std::string& imagePath, DTexFormat format,
+                         uint32_t width, uint32_t height,
+                         const std::vector<DTexLevel>& levels,
+                         const std::vector<uint8_t>& payload) {
+  static_assert(sizeof(DTexHeader) % alignof(DTexLevel) == 0,
+                "Таблица уровней в .dtex должна быть выровнена");
+
+  DTexHeader h = {};
+  std::memcpy(h.magic, kMagic, sizeof(kMagic));
+  h.version = kDTexVersion;
+  h.format = static_cast<uint32_t>(format);
+  h.width = width;
+  h.height = height;
+  h.mipCount = static_cast<uint32_t>(levels.size());
+  h.payloadHash = hashBytes(payload.data(), payload.size());
+
+  if (!fileStamp(imagePath, h.sourceSize, h.sourceMtime) ||
+      !fileHash(imagePath, h.sourceHash)) {
+    return false;
+  }
+
+  return writeFileAtomically(
+      cachePath(imagePath),
+      {{&h, sizeof(h)},
+       {levels.data(), levels.size() * sizeof(DTexLevel)},
+       {payload.data(), payload.size()}});
+}
@@ -0,0 +1,279 @@
+#include "texture_cooker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Цвет RGB565 и его развёртка обратно в 8 бит на канал
+uint16_t packRGB565(const float* c) {
+  int r = std::clamp(static_cast<int>(std::lround(c[0] * 31.0f / 255.0f)), 0,
+                     31);
+  int g = std::clamp(static_cast<int>(std::lround(c[1] * 63.0f / 255.0f)), 0,
+                     63);
+  int b = std::clamp(static_cast<int>(std::lround(c[2] * 31.0f / 255.0f)), 0,
+                     31);
+  return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void unpackRGB565(uint16_t c, int* out) {
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  out[0] = (r << 3) | (r >> 2);
+  out[1] = (g << 2) | (g >> 4);
+  out[2] = (b << 3) | (b >> 2);
+}
+
+// Цветовой блок BC1 в режиме четырёх цветов.
+//
+// Концы отрезка палитры берутся по главной оси разброса цветов блока:
+// ось находится степенным методом по ковариации, а концами становятся
+// пиксели с крайними проекциями на неё.
+void encodeColorBlock(const uint8_t* rgba, uint8_t* out) {
+  float mean[3] = {0.0f, 0.0f, 0.0f};
+  for (int i = 0; i < 16; i++) {
+    for (int c = 0; c < 3; c++) mean[c] += rgba[i * 4 + c];
+  }
+  for (int c = 0; c < 3; c++) mean[c] /= 16.0f;
+
+  float cov[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  for (int i = 0; i < 16; i++) {
+    float r = rgba[i * 4 + 0] - mean[0];
+    float g = rgba[i * 4 + 1] - mean[1];
+    float b = rgba[i * 4 + 2] - mean[2];
+    cov[0] += r * r;
+    cov[1] += r * g;
+    cov[2] += r * b;
+    cov[3] += g * g;
+    cov[4] += g * b;
+    cov[5] += b * b;
+  }
+
+  float axis[3] = {1.0f, 1.0f, 1.0f};
+  for (int iter = 0; iter < 4; iter++) {
+    float x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+    float y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+    float z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+    float len = std::max({std::fabs(x), std::fabs(y), std::fabs(z)});
+    if (len < 1e-6f) break;
+    axis[0] = x / len;
+    axis[1] = y / len;
+    axis[2] = z / len;
+  }
+
+  int minIdx = 0, maxIdx = 0;
+  float minDot = 0.0f, maxDot = 0.0f;
+  for (int i = 0; i < 16; i++) {
+    float d = rgba[i * 4 + 0] * axis[0] + rgba[i * 4 + 1] * axis[1] +
+              rgba[i * 4 + 2] * axis[2];
+    if (i == 0 || d < minDot) {
+      minDot = d;
+      minIdx = i;
+    }
+    if (i == 0 || d > maxDot) {
+      maxDot = d;
+      maxIdx = i;
+    }
+  }
+
+  float maxColor[3], minColor[3];
+  for (int c = 0; c < 3; c++) {
+    maxColor[c] = rgba[maxIdx * 4 + c];
+    minColor[c] = rgba[minIdx * 4 + c];
+  }
+  uint16_t c0 = packRGB565(maxColor);
+  uint16_t c1 = packRGB565(minColor);
+
+  // c0 > c1 включает режим четырёх цветов без прозрачности
+  if (c0 < c1) std::swap(c0, c1);
+
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    int palette[4][3];
+    unpackRGB565(c0, palette[0]);
+    unpackRGB565(c1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    for (int i = 0; i < 16; i++) {
+      int best = 0, bestError = 0;
+      for (int p = 0; p < 4; p++) {
+        int error = 0;
+        for (int c = 0; c < 3; c++) {
+          int d = rgba[i * 4 + c] - palette[p][c];
+          error += d * d;
+        }
+        if (p == 0 || error < bestError) {
+          best = p;
+          bestError = error;
+        }
+      }
+      indices |= static_cast<uint32_t>(best) << (2 * i);
+    }
+  }
+
+  out[0] = c0 & 0xff;
+  out[1] = c0 >> 8;
+  out[2] = c1 & 0xff;
+  out[3] = c1 >> 8;
+  for (int i = 0; i < 4; i++) out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// Альфа-блок BC3 в режиме восьми значений между минимумом и максимумом
+void encodeAlphaBlock(const uint8_t* rgba, uint8_t* out) {
+  int a0 = 0, a1 = 255;
+  for (int i = 0; i < 16; i++) {
+    a0 = std::max<int>(a0, rgba[i * 4 + 3]);
+    a1 = std::min<int>(a1, rgba[i * 4 + 3]);
+  }
+
+  uint64_t indices = 0;
+  if (a0 != a1) {
+    int palette[8];
+    palette[0] = a0;
+    palette[1] = a1;
+    for (int p = 1; p < 7; p++) {
+      palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+    }
+
+    for (int i = 0; i < 16; i++) {
+      int a = rgba[i * 4 + 3];
+      int best = 0, bestError = 256;
+      for (int p = 0; p < 8; p++) {
+        int error = std::abs(a - palette[p]);
+        if (error < bestError) {
+          best = p;
+          bestError = error;
+        }
+      }
+      indices |= static_cast<uint64_t>(best) << (3 * i);
+    }
+  }
+
+  out[0] = static_cast<uint8_t>(a0);
+  out[1] = static_cast<uint8_t>(a1);
+  for (int i = 0; i < 6; i++) out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+// Уменьшить уровень вдвое усреднением 2x2; нечётный край повторяется
+void downsample(const std::vector<uint8_t>& src, uint32_t width,
+                uint32_t height, std::vector<uint8_t>& dst,
+                uint32_t dstWidth, uint32_t dstHeight) {
+  dst.resize(static_cast<size_t>(dstWidth) * dstHeight * 4);
+  for (uint32_t y = 0; y < dstHeight; y++) {
+    uint32_t y0 = std::min(y * 2, height - 1);
+    uint32_t y1 = std::min(y * 2 + 1, height - 1);
+    for (uint32_t x = 0; x < dstWidth; x++) {
+      uint32_t x0 = std::min(x * 2, width - 1);
+      uint32_t x1 = std::min(x * 2 + 1, width - 1);
+      for (int c = 0; c < 4; c++) {
+        int sum = src[(static_cast<size_t>(y0) * width + x0) * 4 + c] +
+                  src[(static_cast<size_t>(y0) * width + x1) * 4 + c] +
+                  src[(static_cast<size_t>(y1) * width + x0) * 4 + c] +
+                  src[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+        dst[(static_cast<size_t>(y) * dstWidth + x) * 4 + c] =
+            static_cast<uint8_t>((sum + 2) / 4);
+      }
+    }
+  }
+}
+
+// Сжать уровень блоками 4x4; блоки на краю дополняются крайними пикселями
+void compressLevel(const std::vector<uint8_t>& rgba, uint32_t width,
+                   uint32_t height, DTexFormat format, uint8_t* out) {
+  const size_t blockBytes = format == DTexFormat::BC1 ? 8 : 16;
+  uint8_t block[64];
+
+  for (uint32_t by = 0; by < height; by += 4) {
+    for (uint32_t bx = 0; bx < width; bx += 4) {
+      for (uint32_t y = 0; y < 4; y++) {
+        uint32_t sy = std::min(by + y, height - 1);
+        for (uint32_t x = 0; x < 4; x++) {
+          uint32_t sx = std::min(bx + x, width - 1);
+          std::memcpy(block + (y * 4 + x) * 4,
+                      &rgba[(static_cast<size_t>(sy) * width + sx) * 4], 4);
+        }
+      }
+
+      if (format == DTexFormat::BC1) {
+        encodeBC1Block(block, out);
+      } else {
+        encodeBC3Block(block, out);
+      }
+      out += blockBytes;
+    }
+  }
+}
+
+}  // namespace
+
+void encodeBC1Block(const uint8_t* rgba, uint8_t* out) {
+  encodeColorBlock(rgba, out);
+}
+
+void encodeBC3Block(const uint8_t* rgba, uint8_t* out) {
+  encodeAlphaBlock(rgba, out);
+  encodeColorBlock(rgba, out + 8);
+}
+
+size_t levelByteSize(DTexFormat format, uint32_t width, uint32_t height) {
+  if (format == DTexFormat::RGBA8) {
+    return static_cast<size_t>(width) * height * 4;
+  }
+  const size_t blocks =
+      static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4);
+  return blocks * (format == DTexFormat::BC1 ? 8 : 16);
+}
+
+bool isOpaque(const uint8_t* rgba, uint32_t width, uint32_t height) {
+  const size_t count = static_cast<size_t>(width) * height;
+  for (size_t i = 0; i < count; i++) {
+    if (rgba[i * 4 + 3] != 255) return false;
+  }
+  return true;
+}
+
+void cookTexture(const uint8_t* rgba, uint32_t width, uint32_t height,
+                 DTexFormat format, std::vector<DTexLevel>& levels,
+                 std::vector<uint8_t>& payload) {
+  levels.clear();
+  payload.clear();
+  if (width == 0 || height == 0) return;
+
+  // Нулевой уровень сразу переворачивается в порядок строк OpenGL
+  const size_t rowBytes = static_cast<size_t>(width) * 4;
+  std::vector<uint8_t> level(rowBytes * height);
+  for (uint32_t y = 0; y < height; y++) {
+    std::memcpy(&level[y * rowBytes], rgba + (height - 1 - y) * rowBytes,
+                rowBytes);
+  }
+
+  std::vector<uint8_t> next;
+  uint32_t w = width, h = height;
+  while (true) {
+    DTexLevel info;
+    info.width = w;
+    info.height = h;
+    info.offset = payload.size();
+    info.size = levelByteSize(format, w, h);
+    levels.push_back(info);
+
+    payload.resize(info.offset + info.size);
+    if (format == DTexFormat::RGBA8) {
+      std::memcpy(&payload[info.offset], level.data(), info.size);
+    } else {
+      compressLevel(level, w, h, format, &payload[info.offset]);
+    }
+
+    if (w == 1 && h == 1) break;
+
+    uint32_t nextW = std::max(1u, w / 2);
+    uint32_t nextH = std::max(1u, h / 2);
+    downsample(level, w, h, next, nextW, nextH);
+    level.swap(next);
+    w = nextW;
+    h = nextH;
+  }
+}
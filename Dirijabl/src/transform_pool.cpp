@@ -0,0 +1,347 @@
+#include "transform_pool.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRANSFORM_POOL_SSE 1
+#endif
+
+namespace {
+
+// Один экземпляр: матрица T * R * S из единичного кватерниона
+void composeScalar(const glm::vec3& p, const glm::quat& q, const glm::vec3& s,
+                   InstanceTransform& instance) {
+  glm::mat4& out = instance.model;
+  const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+  const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+  const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+  out[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz),
+                     2.0f * (xz - wy), 0.0f) * s.x;
+  out[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz),
+                     2.0f * (yz + wx), 0.0f) * s.y;
+  out[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx),
+                     1.0f - 2.0f * (xx + yy), 0.0f) * s.z;
+  out[3] = glm::vec4(p, 1.0f);
+  instance.normalScale = glm::vec4(1.0f / (s * s), 0.0f);
+}
+
+#ifdef TRANSFORM_POOL_SSE
+// Четыре экземпляра за раз. Входы раскладываются по компонентам (x четырёх
+// экземпляров в одном регистре и т. д.), элементы матриц считаются
+// вертикально, а столбцы собираются транспонированием 4x4.
+void composeSSE4(const glm::vec3* p, const glm::quat* r, const glm::vec3* s,
+                 InstanceTransform* out) {
+  static_assert(sizeof(glm::quat) == 4 * sizeof(float),
+                "Кватернион должен занимать 4 float");
+  static_assert(sizeof(InstanceTransform) == 20 * sizeof(float),
+                "Данные экземпляра должны занимать 20 float");
+
+  // Порядок полей glm::quat зависит от настроек glm, поэтому поля
+  // читаются по имени
+  __m128 qx = _mm_setr_ps(r[0].x, r[1].x, r[2].x, r[3].x);
+  __m128 qy = _mm_setr_ps(r[0].y, r[1].y, r[2].y, r[3].y);
+  __m128 qz = _mm_setr_ps(r[0].z, r[1].z, r[2].z, r[3].z);
+  __m128 qw = _mm_setr_ps(r[0].w, r[1].w, r[2].w, r[3].w);
+
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 zero = _mm_setzero_ps();
+
+  __m128 x2 = _mm_mul_ps(qx, two), y2 = _mm_mul_ps(qy, two),
+         z2 = _mm_mul_ps(qz, two);
+  __m128 xx = _mm_mul_ps(qx, x2), yy = _mm_mul_ps(qy, y2),
+         zz = _mm_mul_ps(qz, z2);
+  __m128 xy = _mm_mul_ps(qx, y2), xz = _mm_mul_ps(qx, z2),
+         yz = _mm_mul_ps(qy, z2);
+  __m128 wx = _mm_mul_ps(qw, x2), wy = _mm_mul_ps(qw, y2),
+         wz = _mm_mul_ps(qw, z2);
+
+  __m128 sx = _mm_setr_ps(s[0].x, s[1].x, s[2].x, s[3].x);
+  __m128 sy = _mm_setr_ps(s[0].y, s[1].y, s[2].y, s[3].y);
+  __m128 sz = _mm_setr_ps(s[0].z, s[1].z, s[2].z, s[3].z);
+
+  // Столбцы поворота, умноженные на масштаб
+  __m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx);
+  __m128 c0y = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+  __m128 c0z = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+
+  __m128 c1x = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+  __m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy);
+  __m128 c1z = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+
+  __m128 c2x = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+  __m128 c2y = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+  __m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz);
+
+  __m128 c3x = _mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x);
+  __m128 c3y = _mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y);
+  __m128 c3z = _mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z);
+  __m128 c3w = one;
+
+  // После транспонирования в c*x лежит столбец первой матрицы и т. д.
+  __m128 c0w = zero, c1w = zero, c2w = zero;
+  _MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+  _MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+  _MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+  _MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+
+  const __m128 columns[4][4] = {{c0x, c1x, c2x, c3x},
+                                {c0y, c1y, c2y, c3y},
+                                {c0z, c1z, c2z, c3z},
+                                {c0w, c1w, c2w, c3w}};
+  // Множители нормалей 1 / scale^2
+  __m128 nx = _mm_div_ps(one, _mm_mul_ps(sx, sx));
+  __m128 ny = _mm_div_ps(one, _mm_mul_ps(sy, sy));
+  __m128 nz = _mm_div_ps(one, _mm_mul_ps(sz, sz));
+  __m128 nw = zero;
+  _MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+  const __m128 normalScales[4] = {nx, ny, nz, nw};
+
+  for (int i = 0; i < 4; i++) {
+    float* m = &out[i].model[0][0];
+    _mm_storeu_ps(m + 0, columns[i][0]);
+    _mm_storeu_ps(m + 4, columns[i][1]);
+    _mm_storeu_ps(m + 8, columns[i][2]);
+    _mm_storeu_ps(m + 12, columns[i][3]);
+    _mm_storeu_ps(&out[i].normalScale[0], normalScales[i]);
+  }
+}
+#endif
+
+}  // namespace
+
+void composeTransforms(const glm::vec3* positions, const glm::quat* rotations,
+                       const glm::vec3* scales, InstanceTransform* out,
+                       size_t count) {
+  size_t i = 0;
+#ifdef TRANSFORM_POOL_SSE
+  for (; i + 4 <= count; i += 4) {
+    composeSSE4(positions + i, rotations + i, scales + i, out + i);
+  }
+#endif
+  for (; i < count; i++) {
+    composeScalar(positions[i], rotations[i], scales[i], out[i]);
+  }
+}
+
+uint32_t TransformPool::denseIndex(Handle handle) const {
+  if (handle.index >= indexToDense.size() ||
+      generations[handle.index] != handle.generation) {
+    return kInvalid;
+  }
+  return indexToDense[handle.index];
+}
+
+void TransformPool::reserve(size_t count) {
+  positions.reserve(count);
+  rotationAxes.reserve(count);
+  rotationAngles.reserve(count);
+  rotations.reserve(count);
+  scales.reserve(count);
+  instanceTransforms.reserve(count);
+  denseToIndex.reserve(count);
+  flags.reserve(count);
+}
+
+TransformPool::Handle TransformPool::create() {
+  Handle handle;
+  if (!freeIndices.empty()) {
+    handle.index = freeIndices.back();
+    freeIndices.pop_back();
+  } else {
+    handle.index = static_cast<uint32_t>(indexToDense.size());
+    indexToDense.push_back(kInvalid);
+    generations.push_back(0);
+  }
+  handle.generation = generations[handle.index];
+
+  const uint32_t dense = static_cast<uint32_t>(positions.size());
+  indexToDense[handle.index] = dense;
+  positions.push_back(glm::vec3(0.0f));
+  rotationAxes.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+  rotationAngles.push_back(0.0f);
+  rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+  scales.push_back(glm::vec3(1.0f));
+  instanceTransforms.push_back(
+      {glm::mat4(1.0f), glm::vec4(1.0f, 1.0f, 1.0f, 0.0f)});
+  denseToIndex.push_back(handle.index);
+  flags.push_back(0);
+  mark(dense, kUploadPending);
+  return handle;
+}
+
+bool TransformPool::remove(Handle handle) {
+  const uint32_t dense = denseIndex(handle);
+  if (dense == kInvalid) return false;
+
+  // Последний элемент переезжает на место удалённого
+  const uint32_t last = static_cast<uint32_t>(positions.size() - 1);
+  if (dense != last) {
+    positions[dense] = positions[last];
+    rotationAxes[dense] = rotationAxes[last];
+    rotationAngles[dense] = rotationAngles[last];
+    rotations[dense] = rotations[last];
+    scales[dense] = scales[last];
+    instanceTransforms[dense] = instanceTransforms[last];
+    denseToIndex[dense] = denseToIndex[last];
+    indexToDense[denseToIndex[dense]] = dense;
+
+    const uint8_t movedFlags = flags[last];
+    flags[dense] = 0;
+    mark(dense, (movedFlags & kMatrixPending) | kUploadPending);
+  }
+
+  positions.pop_back();
+  rotationAxes.pop_back();
+  rotationAngles.pop_back();
+  rotations.pop_back();
+  scales.pop_back();
+  instanceTransforms.pop_back();
+  denseToIndex.pop_back();
+  flags.pop_back();
+
+  // Старые дескрипторы этой ячейки становятся недействительными
+  indexToDense[handle.index] = kInvalid;
+  generations[handle.index]++;
+  freeIndices.push_back(handle.index);
+  return true;
+}
+
+void TransformPool::mark(uint32_t dense, uint8_t bits) {
+  const uint8_t added = bits & ~flags[dense];
+  if (!added) return;
+  flags[dense] |= added;
+  if (added & kMatrixPending) matrixList.push_back(dense);
+  if (added & kUploadPending) uploadList.push_back(dense);
+}
+
+void TransformPool::setPosition(Handle handle, const glm::vec3& position) {
+  const uint32_t dense = denseIndex(handle);
+  if (dense == kInvalid) return;
+  positions[dense] = position;
+  mark(dense, kMatrixPending);
+}
+
+void TransformPool::setRotation(Handle handle, const glm::vec3& axis,
+                                float angleDegrees) {
+  const uint32_t dense = denseIndex(handle);
+  if (dense == kInvalid) return;
+  rotationAxes[dense] = glm::normalize(axis);
+  rotationAngles[dense] = angleDegrees;
+  updateRotation(dense);
+}
+
+void TransformPool::setScale(Handle handle, const glm::vec3& scale) {
+  const uint32_t dense = denseIndex(handle);
+  if (dense == kInvalid) return;
+  scales[dense] = scale;
+  mark(dense, kMatrixPending);
+}
+
+void TransformPool::translate(Handle handle, const glm::vec3& translation) {
+  const uint32_t dense = denseIndex(handle);
+  if (dense == kInvalid) return;
+  positions[dense] += translation;
+  mark(dense, kMatrixPending);
+}
+
+void TransformPool::rotate(Handle handle, const glm::vec3& axis,
+                           float angleDegrees) {
+  const uint32_t dense = denseIndex(handle);
+  if (dense == kInvalid) return;
+  rotationAxes[dense] = glm::normalize(axis);
+  rotationAngles[dense] += angleDegrees;
+  updateRotation(dense);
+}
+
+void TransformPool::updateRotation(uint32_t dense) {
+  rotations[dense] = glm::angleAxis(glm::radians(rotationAngles[dense]),
+                                    rotationAxes[dense]);
+  mark(dense, kMatrixPending);
+}
+
+void TransformPool::scaleBy(Handle handle, const glm::vec3& scaling) {
+  const uint32_t dense = denseIndex(handle);
+  if (dense == kInvalid) return;
+  scales[dense] *= scaling;
+  mark(dense, kMatrixPending);
+}
+
+glm::vec3 TransformPool::getPosition(Handle handle) const {
+  const uint32_t dense = denseIndex(handle);
+  return dense == kInvalid ? glm::vec3(0.0f) : positions[dense];
+}
+
+glm::vec3 TransformPool::getScale(Handle handle) const {
+  const uint32_t dense = denseIndex(handle);
+  return dense == kInvalid ? glm::vec3(1.0f) : scales[dense];
+}
+
+glm::vec3 TransformPool::getRotationAxis(Handle handle) const {
+  const uint32_t dense = denseIndex(handle);
+  return dense == kInvalid ? glm::vec3(0.0f, 1.0f, 0.0f)
+                           : rotationAxes[dense];
+}
+
+float TransformPool::getRotationAngle(Handle handle) const {
+  const uint32_t dense = denseIndex(handle);
+  return dense == kInvalid ? 0.0f : rotationAngles[dense];
+}
+
+glm::mat4 TransformPool::getMatrix(Handle handle) const {
+  const uint32_t dense = denseIndex(handle);
+  if (dense == kInvalid) return glm::mat4(1.0f);
+  if (!(flags[dense] & kMatrixPending)) {
+    return instanceTransforms[dense].model;
+  }
+
+  InstanceTransform result;
+  composeTransforms(&positions[dense], &rotations[dense], &scales[dense],
+                    &result, 1);
+  return result.model;
+}
+
+void TransformPool::updateMatrices() {
+  if (matrixList.empty()) return;
+
+  // По возрастанию индексов массивы читаются подряд
+  std::sort(matrixList.begin(), matrixList.end());
+
+  const uint32_t count = static_cast<uint32_t>(positions.size());
+  size_t i = 0;
+  while (i < matrixList.size()) {
+    const uint32_t first = matrixList[i];
+    if (first >= count) break;
+    if (!(flags[first] & kMatrixPending)) {
+      i++;
+      continue;
+    }
+
+    // Непрерывная серия изменённых экземпляров собирается одним вызовом
+    uint32_t end = first;
+    while (i < matrixList.size() && matrixList[i] == end &&
+           end < count && (flags[end] & kMatrixPending)) {
+      end++;
+      i++;
+    }
+
+    composeTransforms(&positions[first], &rotations[first], &scales[first],
+                      &instanceTransforms[first], end - first);
+    for (uint32_t dense = first; dense < end; dense++) {
+      flags[dense] &= ~kMatrixPending;
+      mark(dense, kUploadPending);
+    }
+  }
+  matrixList.clear();
+}
+
+void TransformPool::clearUploadList() {
+  const uint32_t count = static_cast<uint32_t>(positions.size());
+  for (uint32_t dense : uploadList) {
+    if (dense < count) flags[dense] &= ~kUploadPending;
+  }
+  uploadList.clear();
+}
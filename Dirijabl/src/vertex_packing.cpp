@@ -0,0 +1,88 @@
+#include "vertex_packing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+PositionDecode makePositionDecode(const Bounds& bounds) {
+  PositionDecode decode;
+  decode.offset = bounds.min;
+  decode.scale = bounds.max - bounds.min;
+  return decode;
+}
+
+uint16_t floatToHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  const uint32_t sign = (bits >> 16) & 0x8000u;
+  const uint32_t rawExponent = (bits >> 23) & 0xffu;
+  uint32_t mantissa = bits & 0x7fffffu;
+
+  // Бесконечность и NaN
+  if (rawExponent == 0xffu) {
+    return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+  }
+
+  const int exponent = static_cast<int>(rawExponent) - 127 + 15;
+  if (exponent >= 31) {
+    return static_cast<uint16_t>(sign | 0x7c00u);  // Переполнение
+  }
+
+  if (exponent <= 0) {
+    // Денормализованное число или ноль
+    if (exponent < -10) return static_cast<uint16_t>(sign);
+    mantissa |= 0x800000u;
+    const uint32_t shift = static_cast<uint32_t>(14 - exponent);
+    uint32_t half = mantissa >> shift;
+    const uint32_t rest = mantissa & ((1u << shift) - 1u);
+    const uint32_t halfway = 1u << (shift - 1u);
+    if (rest > halfway || (rest == halfway && (half & 1u))) half++;
+    return static_cast<uint16_t>(sign | half);
+  }
+
+  // Перенос при округлении правильно переходит в порядок
+  uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+  const uint32_t rest = mantissa & 0x1fffu;
+  if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) half++;
+  return static_cast<uint16_t>(sign | half);
+}
+
+namespace {
+
+uint32_t packSnorm10(float value) {
+  const float clamped = std::clamp(value, -1.0f, 1.0f);
+  const int32_t fixed = static_cast<int32_t>(std::lround(clamped * 511.0f));
+  return static_cast<uint32_t>(fixed) & 0x3ffu;
+}
+
+uint16_t packUnorm16(float value, float offset, float scale) {
+  if (scale <= 0.0f) return 0;
+  const float t = std::clamp((value - offset) / scale, 0.0f, 1.0f);
+  return static_cast<uint16_t>(std::lround(t * 65535.0f));
+}
+
+}  // namespace
+
+uint32_t packNormal(const glm::vec3& normal) {
+  return packSnorm10(normal.x) | (packSnorm10(normal.y) << 10) |
+         (packSnorm10(normal.z) << 20);
+}
+
+void packVertices(const ModelVertex* vertices, size_t count,
+                  const PositionDecode& decode,
+                  std::vector<PackedVertex>& packed) {
+  packed.resize(count);
+  for (size_t i = 0; i < count; i++) {
+    const ModelVertex& v = vertices[i];
+    PackedVertex& p = packed[i];
+    for (int axis = 0; axis < 3; axis++) {
+      p.position[axis] = packUnorm16(v.position[axis], decode.offset[axis],
+                                     decode.scale[axis]);
+    }
+    p.position[3] = 0;
+    p.normal = packNormal(v.normal);
+    p.texCoord[0] = floatToHalf(v.texCoord.x);
+    p.texCoord[1] = floatToHalf(v.texCoord.y);
+  }
+}
@@ -0,0 +1,71 @@
+// Заранее подготовить кэш .dmesh для obj-файлов.
+//
+//   mesh-cook models/*.obj
+//
+// Повторяет то же, что Model::load делает при первом запуске: разбор,
+// склейку вершин, построение уровней детализации, перестановку под кэш
+// вершин и запись <файл>.dmesh рядом с исходником. Для каждого файла
+// печатает ACMR и ATVR уровня 0 до и после перестановки.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "obj_parser.h"
+#include "thread_pool.h"
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Использование: mesh-cook <файл.obj>..." << std::endl;
+    return 1;
+  }
+
+  int failed = 0;
+  for (int i = 1; i < argc; i++) {
+    const std::string filename = argv[i];
+
+    MappedFile file(filename);
+    if (!file.isOpen()) {
+      std::cerr << "Не получилось открыть файл: " << filename << std::endl;
+      failed++;
+      continue;
+    }
+
+    ObjData obj;
+    std::vector<ModelVertex> vertices;
+    std::vector<unsigned int> indices;
+    WeldStats stats;
+    std::string error;
+    if (!parseObjParallel(file.data(), file.data() + file.size(), obj, error,
+                          ThreadPool::shared()) ||
+        !buildObjMesh(obj, 0.0f, vertices, indices, stats, error)) {
+      std::cerr << filename << ": " << error << std::endl;
+      failed++;
+      continue;
+    }
+    file.close();
+
+    std::vector<MeshLod> lods;
+    buildMeshLods(vertices, indices, kDefaultLodLevels, lods);
+
+    VertexCacheStats before, after;
+    optimizeMesh(vertices, indices, lods, before, after);
+
+    if (!MeshCache::write(filename, 0.0f, kDefaultLodLevels, vertices, indices,
+                          lods)) {
+      failed++;
+      continue;
+    }
+    std::cout << MeshCache::cachePath(filename) << ": " << vertices.size()
+              << " вершин, треугольников по уровням:";
+    for (const MeshLod& lod : lods) std::cout << " " << lod.indexCount / 3;
+    std::cout << "; ACMR " << before.acmr << " -> " << after.acmr << ", ATVR "
+              << before.atvr << " -> " << after.atvr << std::endl;
+  }
+
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+// Замер масштабирования параллельного разбора obj-файла.
+//
+//   obj-bench [файл.obj] [повторов]
+//
+// Для каждого числа потоков печатает лучшее время разбора и склейки и
+// проверяет, что вершины и индексы совпадают с однопоточным разбором.
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mapped_file.h"
+#include "obj_parser.h"
+#include "thread_pool.h"
+
+namespace {
+
+struct Result {
+  std::vector<ModelVertex> vertices;
+  std::vector<unsigned int> indices;
+  double parseMs = 0.0;
+  double buildMs = 0.0;
+};
+
+bool run(const MappedFile& file, ThreadPool* pool, unsigned int chunks,
+         Result& result) {
+  using Clock = std::chrono::steady_clock;
+
+  ObjData obj;
+  std::string error;
+  result.vertices.clear();
+  result.indices.clear();
+
+  auto t0 = Clock::now();
+  bool ok = pool ? parseObjParallel(file.data(), file.data() + file.size(),
+                                    obj, error, *pool, chunks)
+                 : parseObj(file.data(), file.data() + file.size(), obj, error);
+  auto t1 = Clock::now();
+  WeldStats stats;
+  ok = ok && buildObjMesh(obj, 0.0f, result.vertices, result.indices, stats,
+                          error);
+  auto t2 = Clock::now();
+
+  if (!ok) {
+    std::cerr << "Ошибка разбора: " << error << std::endl;
+    return false;
+  }
+  result.parseMs = std::chrono::duration<double, std::milli>(t1 - t0).count();
+  result.buildMs = std::chrono::duration<double, std::milli>(t2 - t1).count();
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string filename = argc > 1 ? argv[1] : "models/table.obj";
+  int repeats = argc > 2 ? std::max(1, std::stoi(argv[2])) : 10;
+
+  MappedFile file(filename);
+  if (!file.isOpen()) {
+    std::cerr << "Не получилось открыть файл: " << filename << std::endl;
+    return 1;
+  }
+
+  // Эталон — однопоточный разбор
+  Result reference;
+  double serialMs = 1e9;
+  for (int r = 0; r < repeats; r++) {
+    if (!run(file, nullptr, 1, reference)) return 1;
+    serialMs = std::min(serialMs, reference.parseMs);
+  }
+
+  std::cout << filename << ": " << file.size() / 1024 << " КБ, "
+            << reference.vertices.size() << " вершин, "
+            << reference.indices.size() << " индексов" << std::endl;
+  std::cout << "потоков  разбор, мс  ускорение  склейка, мс  результат"
+            << std::endl;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << std::setw(7) << 1 << std::setw(12) << serialMs << std::setw(11)
+            << 1.0 << std::setw(13) << reference.buildMs << "  эталон"
+            << std::endl;
+
+  unsigned int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<unsigned int> threadCounts;
+  for (unsigned int t = 2; t < maxThreads; t *= 2) threadCounts.push_back(t);
+  threadCounts.push_back(std::max(2u, maxThreads));
+
+  bool allSame = true;
+  for (unsigned int threads : threadCounts) {
+    ThreadPool pool(threads);
+    Result result;
+    double bestMs = 1e9;
+    for (int r = 0; r < repeats; r++) {
+      if (!run(file, &pool, threads, result)) return 1;
+      bestMs = std::min(bestMs, result.parseMs);
+    }
+
+    bool same = result.vertices == reference.vertices &&
+                result.indices == reference.indices;
+    allSame = allSame && same;
+    std::cout << std::setw(7) << threads << std::setw(12) << bestMs
+              << std::setw(11) << serialMs / bestMs << std::setw(13)
+              << result.buildMs << "  " << (same ? "совпадает" : "ОТЛИЧАЕТСЯ")
+              << std::endl;
+  }
+
+  return allSame ? 0 : 1;
+}
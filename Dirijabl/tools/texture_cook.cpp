@@ -0,0 +1,108 @@
+// Заранее подготовить текстуры: цепочка мип-уровней и сжатие S3TC.
+//
+//   texture-cook [--format auto|rgba|bc1|bc3] textures/*.png textures/*.jpg
+//
+// Рядом с каждым изображением записывается <файл>.dtex, который
+// Texture::load читает вместо декодирования и glGenerateMipmap.
+// По умолчанию (auto) непрозрачные изображения сжимаются в BC1,
+// а с альфа-каналом — в BC3.
+
+#include <SFML/Graphics.hpp>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "texture_cache.h"
+#include "texture_cooker.h"
+
+int main(int argc, char** argv) {
+  std::string formatArg = "auto";
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      formatArg = argv[++i];
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+
+  if (files.empty() || (formatArg != "auto" && formatArg != "rgba" &&
+                        formatArg != "bc1" && formatArg != "bc3")) {
+    std::cerr << "Использование: texture-cook [--format auto|rgba|bc1|bc3] "
+                 "<изображение>..."
+              << std::endl;
+    return 1;
+  }
+
+  int failed = 0;
+  size_t totalRaw = 0, totalCooked = 0;
+  for (const auto& filename : files) {
+    sf::Image image;
+    if (!image.loadFromFile(filename)) {
+      std::cerr << "Не удалось загрузить текстуру: " << filename << std::endl;
+      failed++;
+      continue;
+    }
+
+    sf::Vector2u size = image.getSize();
+    const uint8_t* pixels = image.getPixelsPtr();
+
+    DTexFormat format = DTexFormat::RGBA8;
+    if (formatArg == "bc1") {
+      format = DTexFormat::BC1;
+    } else if (formatArg == "bc3") {
+      format = DTexFormat::BC3;
+    } else if (formatArg == "auto") {
+      format = isOpaque(pixels, size.x, size.y) ? DTexFormat::BC1
+                                                : DTexFormat::BC3;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<DTexLevel> levels;
+    std::vector<uint8_t> payload;
+    cookTexture(pixels, size.x, size.y, format, levels, payload);
+    auto cookTime = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+
+    if (!TextureCache::write(filename, format, size.x, size.y, levels,
+                             payload)) {
+      failed++;
+      continue;
+    }
+
+    // То же изображение без сжатия вместе с мип-уровнями — столько раньше
+    // занимала текстура после glGenerateMipmap
+    size_t rawBytes = 0;
+    for (const auto& level : levels) {
+      rawBytes += levelByteSize(DTexFormat::RGBA8, level.width, level.height);
+    }
+    totalRaw += rawBytes;
+    totalCooked += payload.size();
+
+    std::error_code ec;
+    auto sourceBytes = std::filesystem::file_size(filename, ec);
+    std::cout << TextureCache::cachePath(filename) << ": " << size.x << "x"
+              << size.y << ", " << dtexFormatName(format) << ", "
+              << levels.size() << " уровней, " << std::fixed
+              << std::setprecision(1) << cookTime << " мс" << std::endl;
+    std::cout << "  исходник " << (ec ? 0 : sourceBytes) / 1024
+              << " КБ, в GPU было " << rawBytes / 1024 << " КБ, стало "
+              << payload.size() / 1024 << " КБ, сэкономлено "
+              << (rawBytes - payload.size()) / 1024 << " КБ ("
+              << 100.0 * (rawBytes - payload.size()) / rawBytes << "%)"
+              << std::endl;
+  }
+
+  if (totalRaw > 0) {
+    std::cout << "Всего в GPU: было " << totalRaw / 1024 << " КБ, стало "
+              << totalCooked / 1024 << " КБ, сэкономлено "
+              << (totalRaw - totalCooked) / 1024 << " КБ" << std::endl;
+  }
+
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+// Замер сборки матриц экземпляров.
+//
+//   transform-bench [повторов]
+//
+// Для 1k, 100k и 1M экземпляров печатает, сколько матриц в секунду
+// собирается прежним способом (glm::translate/rotate/scale по одной),
+// пакетным composeTransforms() и проходом TransformPool::updateMatrices(),
+// когда изменились все экземпляры, и проверяет, что матрицы и матрицы
+// нормалей совпадают с glm.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "transform_pool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Scene {
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> axes;
+  std::vector<float> angles;
+  std::vector<glm::quat> rotations;
+  std::vector<glm::vec3> scales;
+};
+
+Scene makeScene(size_t count) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<float> coord(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+  std::uniform_real_distribution<float> size(0.1f, 4.0f);
+
+  Scene scene;
+  for (size_t i = 0; i < count; i++) {
+    glm::vec3 axis(unit(rng), unit(rng), unit(rng));
+    if (glm::length(axis) < 1e-3f) axis = glm::vec3(0.0f, 1.0f, 0.0f);
+    axis = glm::normalize(axis);
+    float degrees = angle(rng);
+
+    scene.positions.emplace_back(coord(rng), coord(rng), coord(rng));
+    scene.axes.push_back(axis);
+    scene.angles.push_back(degrees);
+    scene.rotations.push_back(glm::angleAxis(glm::radians(degrees), axis));
+    scene.scales.emplace_back(size(rng), size(rng), size(rng));
+  }
+  return scene;
+}
+
+double millisSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Наибольшее отклонение элемента, отнесённое к его величине
+template <typename Matrix>
+float maxError(const Matrix& a, const Matrix& b, int size) {
+  float error = 0.0f;
+  for (int c = 0; c < size; c++) {
+    for (int r = 0; r < size; r++) {
+      float diff = std::abs(a[c][r] - b[c][r]);
+      error = std::max(error, diff / std::max(1.0f, std::abs(a[c][r])));
+    }
+  }
+  return error;
+}
+
+// Сравнить матрицы и матрицы нормалей с glm
+float maxError(const std::vector<glm::mat4>& reference,
+               const InstanceTransform* instances) {
+  float error = 0.0f;
+  for (size_t i = 0; i < reference.size(); i++) {
+    const InstanceTransform& instance = instances[i];
+    glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(reference[i])));
+    glm::mat3 fast = glm::mat3(instance.model);
+    for (int c = 0; c < 3; c++) fast[c] *= instance.normalScale[c];
+    error = std::max(error, maxError(reference[i], instance.model, 4));
+    error = std::max(error, maxError(normal, fast, 3));
+  }
+  return error;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int repeats = argc > 1 ? std::max(1, std::stoi(argv[1])) : 5;
+
+#if defined(__SSE2__) || defined(_M_X64)
+  const char* kernel = "SSE";
+#else
+  const char* kernel = "скалярное";
+#endif
+  std::cout << "Ядро composeTransforms: " << kernel << std::endl;
+  std::cout << "экземпляров  glm, М/с  пакет, М/с  пул, М/с  ускорение  "
+               "ошибка"
+            << std::endl;
+
+  bool allSame = true;
+  for (size_t count : {size_t(1000), size_t(100000), size_t(1000000)}) {
+    Scene scene = makeScene(count);
+    std::vector<glm::mat4> reference(count);
+    std::vector<InstanceTransform> batched(count);
+
+    TransformPool pool;
+    pool.reserve(count);
+    std::vector<TransformPool::Handle> handles;
+    for (size_t i = 0; i < count; i++) handles.push_back(pool.create());
+
+    double glmMs = 1e9, batchMs = 1e9, poolMs = 1e9;
+    for (int r = 0; r < repeats; r++) {
+      // Прежний способ: цепочка glm на каждый экземпляр
+      auto start = Clock::now();
+      for (size_t i = 0; i < count; i++) {
+        glm::mat4 m = glm::translate(glm::mat4(1.0f), scene.positions[i]);
+        m = glm::rotate(m, glm::radians(scene.angles[i]), scene.axes[i]);
+        reference[i] = glm::scale(m, scene.scales[i]);
+      }
+      glmMs = std::min(glmMs, millisSince(start));
+
+      start = Clock::now();
+      composeTransforms(scene.positions.data(), scene.rotations.data(),
+                        scene.scales.data(), batched.data(), count);
+      batchMs = std::min(batchMs, millisSince(start));
+
+      // Сеттеры помечают все экземпляры, замеряется проход updateMatrices()
+      for (size_t i = 0; i < count; i++) {
+        pool.setPosition(handles[i], scene.positions[i]);
+        pool.setRotation(handles[i], scene.axes[i], scene.angles[i]);
+        pool.setScale(handles[i], scene.scales[i]);
+      }
+      start = Clock::now();
+      pool.updateMatrices();
+      poolMs = std::min(poolMs, millisSince(start));
+      pool.clearUploadList();
+    }
+
+    float error = std::max(maxError(reference, batched.data()),
+                           maxError(reference, pool.getInstanceTransforms()));
+    bool same = error < 1e-4f;
+    allSame = allSame && same;
+
+    auto rate = [count](double ms) { return count / ms / 1000.0; };
+    std::cout << std::fixed << std::setprecision(2) << std::setw(11) << count
+              << std::setw(10) << rate(glmMs) << std::setw(12)
+              << rate(batchMs) << std::setw(10) << rate(poolMs)
+              << std::setw(11) << glmMs / batchMs << "  " << std::scientific
+              << std::setprecision(1) << error << " "
+              << (same ? "совпадает" : "ОТЛИЧАЕТСЯ") << std::endl;
+  }
+
+  return allSame ? 0 : 1;
+}